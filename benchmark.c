@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <sys/time.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <nanorq.h>
 
@@ -91,9 +92,7 @@ int encode(size_t len, uint16_t packet_size, uint16_t num_packets,
   *oti_scheme = nanorq_oti_scheme_specific(rq);
 
   uint8_t num_sbn = nanorq_blocks(rq);
-  for (uint8_t b = 0; b < num_sbn; b++) {
-    nanorq_generate_symbols(rq, b, myio);
-  }
+  nanorq_generate_all(rq, myio, sysconf(_SC_NPROCESSORS_ONLN));
 
   for (uint8_t sbn = 0; sbn < num_sbn; sbn++) {
     dump_block(rq, myio, sbn, packets, overhead_pct);
@@ -111,7 +110,6 @@ int decode(uint64_t oti_common, uint32_t oti_scheme, struct ioctx *myio,
     return -1;
   }
 
-  uint8_t num_sbn = nanorq_blocks(rq);
   uint64_t written = 0;
 
   for (int i = 0; i < kv_size(*packets); i++) {
@@ -121,12 +119,9 @@ int decode(uint64_t oti_common, uint32_t oti_scheme, struct ioctx *myio,
       abort();
     }
   }
-  for (int sbn = 0; sbn < num_sbn; sbn++) {
-    written = nanorq_decode_block(rq, myio, sbn);
-    if (written == 0) {
-      fprintf(stderr, "decode of sbn %d failed.\n", sbn);
-    }
-    nanorq_decode_cleanup(rq, sbn);
+  written = nanorq_decode_all(rq, myio, sysconf(_SC_NPROCESSORS_ONLN));
+  if (written == 0) {
+    fprintf(stderr, "decode failed.\n");
   }
   nanorq_free(rq);
   return 0;
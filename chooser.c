@@ -2,7 +2,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "oblas.h"
 #include "chooser.h"
 
 struct chooser chooser_init(uint16_t tp_size) {
@@ -11,6 +10,7 @@ struct chooser chooser_init(uint16_t tp_size) {
   kv_init(ch.tracking);
   kv_resize(struct tracking_pair, ch.tracking, tp_size);
 
+  kv_init(ch.buckets);
   kv_init(ch.r_rows);
   kv_size(ch.r_rows) = 0;
 
@@ -20,109 +20,149 @@ struct chooser chooser_init(uint16_t tp_size) {
 
 void chooser_clear(struct chooser *ch) {
   kv_destroy(ch->r_rows);
+  kv_destroy(ch->buckets);
   kv_destroy(ch->tracking);
 }
 
 void chooser_add_tracking_pair(struct chooser *ch, bool is_hdpc,
                                size_t row_degree) {
-  struct tracking_pair tp = {is_hdpc, row_degree};
+  struct tracking_pair tp = {is_hdpc, row_degree, row_degree, CHOOSER_NONE,
+                             CHOOSER_NONE};
   kv_push(struct tracking_pair, ch->tracking, tp);
+  if (!is_hdpc && row_degree > ch->max_degree)
+    ch->max_degree = row_degree;
 }
 
-uint16_t chooser_non_zero(struct chooser *ch, octmat *A, struct graph *G,
-                          uint16_t i, uint16_t sub_rows, uint16_t sub_cols) {
-  uint16_t non_zero = sub_cols + 1;
+static size_t chooser_key(struct chooser *ch, struct tracking_pair *tp) {
+  return tp->nnz * (ch->max_degree + 1) + tp->row_degree;
+}
 
-  for (int row = 0; row < sub_rows; row++) {
-    bool next_row = false;
-    int nnz = 0;
-    int ones = 0;
-    int ones_idx[] = {0, 0};
+static void chooser_link(struct chooser *ch, uint16_t row) {
+  struct tracking_pair *tp = &kv_A(ch->tracking, row);
+  size_t key = chooser_key(ch, tp);
 
-    onnz(om_P(*A), row + i, i, sub_cols + i, A->cols, &nnz, &ones, ones_idx);
+  tp->prev = CHOOSER_NONE;
+  tp->next = kv_A(ch->buckets, key);
+  if (tp->next != CHOOSER_NONE)
+    kv_A(ch->tracking, tp->next).prev = row;
+  kv_A(ch->buckets, key) = row;
 
-    if (nnz > non_zero) {
-      next_row = true;
-      break;
-    }
+  if (key < ch->min_key)
+    ch->min_key = key;
+}
 
-    if (next_row || nnz == 0)
-      continue;
+static void chooser_unlink(struct chooser *ch, uint16_t row) {
+  struct tracking_pair *tp = &kv_A(ch->tracking, row);
+
+  if (tp->prev != CHOOSER_NONE) {
+    kv_A(ch->tracking, tp->prev).next = tp->next;
+  } else {
+    kv_A(ch->buckets, chooser_key(ch, tp)) = tp->next;
+  }
+  if (tp->next != CHOOSER_NONE)
+    kv_A(ch->tracking, tp->next).prev = tp->prev;
+  tp->prev = tp->next = CHOOSER_NONE;
+}
+
+/* lazily bucket every row once all tracking pairs are known */
+static void chooser_build(struct chooser *ch) {
+  size_t size = (ch->max_degree + 1) * (ch->max_degree + 1);
+
+  kv_resize(uint32_t, ch->buckets, size);
+  kv_size(ch->buckets) = size;
+  for (size_t key = 0; key < size; key++) {
+    kv_A(ch->buckets, key) = CHOOSER_NONE;
+  }
+  ch->min_key = size;
+
+  for (size_t row = 0; row < kv_size(ch->tracking); row++) {
+    struct tracking_pair *tp = &kv_A(ch->tracking, row);
+    if (!tp->is_hdpc && tp->nnz > 0)
+      chooser_link(ch, row);
+  }
+}
+
+void chooser_decrement(struct chooser *ch, uint16_t row) {
+  struct tracking_pair *tp = &kv_A(ch->tracking, row);
+
+  if (tp->nnz == 0)
+    return;
+  if (tp->is_hdpc || kv_size(ch->buckets) == 0) {
+    tp->nnz--;
+    return;
+  }
+
+  chooser_unlink(ch, row);
+  tp->nnz--;
+  if (tp->nnz > 0)
+    chooser_link(ch, row);
+}
+
+void chooser_remove(struct chooser *ch, uint16_t row) {
+  struct tracking_pair *tp = &kv_A(ch->tracking, row);
+
+  if (tp->nnz > 0 && !tp->is_hdpc && kv_size(ch->buckets) > 0)
+    chooser_unlink(ch, row);
+  tp->nnz = 0;
+}
+
+uint16_t chooser_non_zero(struct chooser *ch) {
+  size_t stride = ch->max_degree + 1;
+
+  if (kv_size(ch->buckets) == 0)
+    chooser_build(ch);
+
+  kv_size(ch->r_rows) = 0;
+  ch->only_two_ones = false;
 
-    // this row has same nnz as last row
-    if (non_zero == nnz) {
-      if (!ch->only_two_ones || ones == 2) {
-        struct pair rp = {row, ones_idx[0]};
-        kv_push(struct pair, ch->r_rows, rp);
+  while (ch->min_key < kv_size(ch->buckets) &&
+         kv_A(ch->buckets, ch->min_key) == CHOOSER_NONE)
+    ch->min_key++;
+
+  if (ch->min_key < kv_size(ch->buckets)) {
+    uint16_t non_zero = ch->min_key / stride;
+    if (non_zero == 2) {
+      // every row with two nonzeros, they are all ones outside of HDPC
+      ch->only_two_ones = true;
+      for (size_t key = ch->min_key; key < 3 * stride; key++) {
+        uint32_t row = kv_A(ch->buckets, key);
+        for (; row != CHOOSER_NONE; row = kv_A(ch->tracking, row).next) {
+          struct pair rp = {row, 0};
+          kv_push(struct pair, ch->r_rows, rp);
+        }
       }
     } else {
-      // this row has lower nnz than last row
-      non_zero = nnz;
-      if (ch->only_two_ones && non_zero == 1) {
-        ch->only_two_ones = false;
-      }
-      kv_size(ch->r_rows) = 0;
-      struct pair rp = {row, ones_idx[0]};
+      struct pair rp = {kv_A(ch->buckets, ch->min_key), 0};
       kv_push(struct pair, ch->r_rows, rp);
     }
+    return non_zero;
+  }
 
-    if (ones == 2) {
-      if (non_zero == 2) {
-        if (kv_A(ch->tracking, row + i).is_hdpc == 0) {
-          graph_link(G, ones_idx[0], ones_idx[1]);
-        }
-        if (!ch->only_two_ones) {
-          ch->only_two_ones = true;
-          kv_size(ch->r_rows) = 0;
-          struct pair rp = {row, ones_idx[0]};
-          kv_push(struct pair, ch->r_rows, rp);
-        }
-      }
+  // only HDPC rows are left
+  uint16_t non_zero = 0;
+  size_t min_degree = SIZE_MAX;
+  for (size_t row = 0; row < kv_size(ch->tracking); row++) {
+    struct tracking_pair *tp = &kv_A(ch->tracking, row);
+    if (!tp->is_hdpc || tp->nnz == 0)
+      continue;
+    if (non_zero == 0 || tp->nnz < non_zero ||
+        (tp->nnz == non_zero && tp->row_degree < min_degree)) {
+      non_zero = tp->nnz;
+      min_degree = tp->row_degree;
+      kv_size(ch->r_rows) = 0;
+      struct pair rp = {row, 0};
+      kv_push(struct pair, ch->r_rows, rp);
     }
   }
   return non_zero;
 }
 
-uint16_t chooser_pick(struct chooser *ch, struct graph *G, uint16_t i,
-                      uint16_t sub_rows, uint16_t non_zero) {
-  uint16_t chosen = sub_rows;
-
-  if (non_zero != 2) {
-    uint16_t min_row = sub_rows;
-    uint16_t min_row_hdpc = min_row;
-    size_t min_degree = SIZE_MAX;
-    size_t min_degree_hdpc = min_degree;
+uint16_t chooser_pick(struct chooser *ch, struct graph *G, uint16_t non_zero) {
+  if (non_zero == 2 && ch->only_two_ones) {
     for (size_t rp_idx = 0; rp_idx < kv_size(ch->r_rows); rp_idx++) {
-      uint16_t row = kv_A(ch->r_rows, rp_idx).first;
-      if (kv_A(ch->tracking, row + i).is_hdpc) {
-        if (kv_A(ch->tracking, row + i).row_degree < min_degree_hdpc) {
-          min_degree_hdpc = kv_A(ch->tracking, row + i).row_degree;
-          min_row_hdpc = row;
-        }
-      } else {
-        if (kv_A(ch->tracking, row + i).row_degree < min_degree) {
-          min_degree = kv_A(ch->tracking, row + i).row_degree;
-          min_row = row;
-        }
-      }
-    }
-    if (min_row != sub_rows) {
-      chosen = min_row;
-    } else {
-      chosen = min_row_hdpc;
-    }
-  } else {
-    if (ch->only_two_ones) {
-      for (size_t rp_idx = 0; rp_idx < kv_size(ch->r_rows); rp_idx++) {
-        if (graph_is_max(G, kv_A(ch->r_rows, rp_idx).second)) {
-          chosen = kv_A(ch->r_rows, rp_idx).first;
-          break;
-        }
-      }
-    }
-    if (chosen == sub_rows) {
-      chosen = kv_A(ch->r_rows, 0).first;
+      if (graph_is_max(G, kv_A(ch->r_rows, rp_idx).second))
+        return kv_A(ch->r_rows, rp_idx).first;
     }
   }
-  return chosen;
+  return kv_A(ch->r_rows, 0).first;
 }
@@ -6,13 +6,26 @@
 #include "graph.h"
 #include "util.h"
 
+#define CHOOSER_NONE UINT32_MAX
+
 struct tracking_pair {
   bool is_hdpc;
   size_t row_degree;
+  uint16_t nnz;  /* live nonzeros of the row inside V */
+  uint32_t prev; /* bucket links */
+  uint32_t next;
 };
 
+/*
+ * rows are kept in buckets keyed by (nnz, row_degree) so the row with the
+ * fewest nonzeros in V, ties broken by original degree, is found without
+ * scanning. HDPC rows stay out of the buckets until nothing else is left.
+ */
 struct chooser {
   kvec_t(struct tracking_pair) tracking;
+  kvec_t(uint32_t) buckets;
+  size_t min_key;
+  size_t max_degree;
   pair_vec r_rows;
   bool only_two_ones;
 };
@@ -21,10 +34,10 @@ struct chooser chooser_init(uint16_t tp_size);
 void chooser_clear(struct chooser *ch);
 void chooser_add_tracking_pair(struct chooser *ch, bool is_hdpc,
                                size_t row_degree);
+void chooser_decrement(struct chooser *ch, uint16_t row);
+void chooser_remove(struct chooser *ch, uint16_t row);
 
-uint16_t chooser_non_zero(struct chooser *ch, octmat *A, struct graph *G,
-                          uint16_t i, uint16_t sub_rows, uint16_t sub_cols);
-uint16_t chooser_pick(struct chooser *ch, struct graph *G, uint16_t i,
-                      uint16_t sub_rows, uint16_t non_zero);
+uint16_t chooser_non_zero(struct chooser *ch);
+uint16_t chooser_pick(struct chooser *ch, struct graph *G, uint16_t non_zero);
 
 #endif
@@ -17,7 +17,7 @@ int main(int argc, char *argv[]) {
     usage(argv[0]);
 
   char *outfile = argv[1];
-  struct ioctx *myio = ioctx_from_file(outfile, 0);
+  struct ioctx *myio = ioctx_from_uring(outfile, 0);
   if (!myio) {
     fprintf(stderr, "couldnt access file %s\n", outfile);
     return -1;
@@ -63,6 +63,11 @@ int main(int argc, char *argv[]) {
   }
   fclose(ih);
   nanorq_free(rq);
+  if (myio->flush && !myio->flush(myio)) {
+    fprintf(stderr, "writing %s failed.\n", outfile);
+    myio->destroy(myio);
+    return -1;
+  }
   myio->destroy(myio);
 
   return 0;
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <nanorq.h>
 
@@ -24,7 +25,15 @@ void dump_esi(nanorq *rq, struct ioctx *myio, FILE *oh, uint8_t sbn,
   }
 }
 
-void dump_block(nanorq *rq, struct ioctx *myio, FILE *oh, uint8_t sbn) {
+struct dump_ctx {
+  struct ioctx *myio;
+  FILE *oh;
+};
+
+bool dump_block(nanorq *rq, uint8_t sbn, void *arg) {
+  struct dump_ctx *ctx = arg;
+  struct ioctx *myio = ctx->myio;
+  FILE *oh = ctx->oh;
   float expected_loss = 6.0;
   int overhead = 5;
 
@@ -43,9 +52,9 @@ void dump_block(nanorq *rq, struct ioctx *myio, FILE *oh, uint8_t sbn) {
     dump_esi(rq, myio, oh, sbn, esi);
     num_rep++;
   }
-  nanorq_encode_cleanup(rq, sbn);
   fprintf(stderr, "block %d is %d packets, dropped %d, created %d repair\n",
           sbn, num_esi, num_dropped, num_rep);
+  return true;
 }
 
 void usage(char *prog) {
@@ -58,7 +67,7 @@ int main(int argc, char *argv[]) {
     usage(argv[0]);
 
   char *infile = argv[1];
-  struct ioctx *myio = ioctx_from_file(infile, 1);
+  struct ioctx *myio = ioctx_from_mmap(infile);
   if (!myio) {
     fprintf(stderr, "couldnt access file %s\n", infile);
     return -1;
@@ -79,18 +88,18 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 
-  uint8_t num_sbn = nanorq_blocks(rq);
-  for (uint8_t b = 0; b < num_sbn; b++) {
-    nanorq_generate_symbols(rq, b, myio);
-  }
+  // each block's solve uses every core while the previous one is dumped
+  nanorq_set_block_threads(rq, sysconf(_SC_NPROCESSORS_ONLN));
 
   uint64_t oti_common = htobe64(nanorq_oti_common(rq));
   uint32_t oti_scheme = htobe32(nanorq_oti_scheme_specific(rq));
   FILE *oh = fopen("data.rq", "w+");
   fwrite(&oti_common, 1, sizeof(oti_common), oh);
   fwrite(&oti_scheme, 1, sizeof(oti_scheme), oh);
-  for (uint8_t sbn = 0; sbn < num_sbn; sbn++) {
-    dump_block(rq, myio, oh, sbn);
+  struct dump_ctx ctx = {.myio = myio, .oh = oh};
+  if (!nanorq_encode_pipeline(rq, myio, 2, dump_block, &ctx)) {
+    fprintf(stderr, "encoding failed.\n");
+    abort();
   }
   fclose(oh);
 
@@ -0,0 +1,363 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include <octmat.h>
+
+#include "gf256.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GF256_X86
+#include <immintrin.h>
+#endif
+
+struct gf256_kernels {
+  const char *name;
+  void (*axpy)(uint8_t *a, const uint8_t *b, size_t len, uint8_t u);
+  void (*addrow)(uint8_t *a, const uint8_t *b, size_t len);
+  void (*scal)(uint8_t *a, size_t len, uint8_t u);
+};
+
+static void gf256_axpy_generic(uint8_t *a, const uint8_t *b, size_t len,
+                               uint8_t u) {
+  int log_u = OCT_LOG[u];
+  for (size_t i = 0; i < len; i++) {
+    if (b[i])
+      a[i] ^= OCT_EXP[log_u + OCT_LOG[b[i]]];
+  }
+}
+
+static void gf256_addrow_generic(uint8_t *a, const uint8_t *b, size_t len) {
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t x, y;
+    memcpy(&x, a + i, sizeof(x));
+    memcpy(&y, b + i, sizeof(y));
+    x ^= y;
+    memcpy(a + i, &x, sizeof(x));
+  }
+  for (; i < len; i++) {
+    a[i] ^= b[i];
+  }
+}
+
+static void gf256_scal_generic(uint8_t *a, size_t len, uint8_t u) {
+  int log_u = OCT_LOG[u];
+  for (size_t i = 0; i < len; i++) {
+    if (a[i])
+      a[i] = OCT_EXP[log_u + OCT_LOG[a[i]]];
+  }
+}
+
+static struct gf256_kernels gf256 = {"generic", gf256_axpy_generic,
+                                     gf256_addrow_generic, gf256_scal_generic};
+
+#ifdef GF256_X86
+/* products of u with every low and high nibble, for the shuffle kernels */
+static uint8_t gf256_lo[256][16], gf256_hi[256][16];
+/* multiplying by u as an 8x8 bit matrix, for gf2p8affineqb. gf2p8mulb is
+ * fixed to the 0x11b polynomial so it can't be used for RaptorQ's 0x11d */
+static uint64_t gf256_affine[256];
+
+__attribute__((target("ssse3"))) static void
+gf256_axpy_ssse3(uint8_t *a, const uint8_t *b, size_t len, uint8_t u) {
+  __m128i lo = _mm_loadu_si128((const __m128i *)gf256_lo[u]);
+  __m128i hi = _mm_loadu_si128((const __m128i *)gf256_hi[u]);
+  __m128i mask = _mm_set1_epi8(0x0f);
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(b + i));
+    __m128i y = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(x, mask));
+    __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(x, 4), mask));
+    _mm_storeu_si128((__m128i *)(a + i), _mm_xor_si128(y, _mm_xor_si128(l, h)));
+  }
+  gf256_axpy_generic(a + i, b + i, len - i, u);
+}
+
+__attribute__((target("ssse3"))) static void
+gf256_addrow_ssse3(uint8_t *a, const uint8_t *b, size_t len) {
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(b + i));
+    __m128i y = _mm_loadu_si128((const __m128i *)(a + i));
+    _mm_storeu_si128((__m128i *)(a + i), _mm_xor_si128(y, x));
+  }
+  gf256_addrow_generic(a + i, b + i, len - i);
+}
+
+__attribute__((target("ssse3"))) static void
+gf256_scal_ssse3(uint8_t *a, size_t len, uint8_t u) {
+  __m128i lo = _mm_loadu_si128((const __m128i *)gf256_lo[u]);
+  __m128i hi = _mm_loadu_si128((const __m128i *)gf256_hi[u]);
+  __m128i mask = _mm_set1_epi8(0x0f);
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(x, mask));
+    __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(x, 4), mask));
+    _mm_storeu_si128((__m128i *)(a + i), _mm_xor_si128(l, h));
+  }
+  gf256_scal_generic(a + i, len - i, u);
+}
+
+__attribute__((target("avx2"))) static void
+gf256_axpy_avx2(uint8_t *a, const uint8_t *b, size_t len, uint8_t u) {
+  __m256i lo = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i *)gf256_lo[u]));
+  __m256i hi = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i *)gf256_hi[u]));
+  __m256i mask = _mm256_set1_epi8(0x0f);
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(b + i));
+    __m256i y = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask));
+    __m256i h = _mm256_shuffle_epi8(
+        hi, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask));
+    _mm256_storeu_si256((__m256i *)(a + i),
+                        _mm256_xor_si256(y, _mm256_xor_si256(l, h)));
+  }
+  gf256_axpy_ssse3(a + i, b + i, len - i, u);
+}
+
+__attribute__((target("avx2"))) static void
+gf256_addrow_avx2(uint8_t *a, const uint8_t *b, size_t len) {
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(b + i));
+    __m256i y = _mm256_loadu_si256((const __m256i *)(a + i));
+    _mm256_storeu_si256((__m256i *)(a + i), _mm256_xor_si256(y, x));
+  }
+  gf256_addrow_ssse3(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2"))) static void
+gf256_scal_avx2(uint8_t *a, size_t len, uint8_t u) {
+  __m256i lo = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i *)gf256_lo[u]));
+  __m256i hi = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128((const __m128i *)gf256_hi[u]));
+  __m256i mask = _mm256_set1_epi8(0x0f);
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask));
+    __m256i h = _mm256_shuffle_epi8(
+        hi, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask));
+    _mm256_storeu_si256((__m256i *)(a + i), _mm256_xor_si256(l, h));
+  }
+  gf256_scal_ssse3(a + i, len - i, u);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void
+gf256_axpy_avx512(uint8_t *a, const uint8_t *b, size_t len, uint8_t u) {
+  __m512i lo =
+      _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)gf256_lo[u]));
+  __m512i hi =
+      _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)gf256_hi[u]));
+  __m512i mask = _mm512_set1_epi8(0x0f);
+  size_t i = 0;
+
+  for (; i + 64 <= len; i += 64) {
+    __m512i x = _mm512_loadu_si512((const void *)(b + i));
+    __m512i y = _mm512_loadu_si512((const void *)(a + i));
+    __m512i l = _mm512_shuffle_epi8(lo, _mm512_and_si512(x, mask));
+    __m512i h = _mm512_shuffle_epi8(
+        hi, _mm512_and_si512(_mm512_srli_epi64(x, 4), mask));
+    _mm512_storeu_si512((void *)(a + i),
+                        _mm512_xor_si512(y, _mm512_xor_si512(l, h)));
+  }
+  gf256_axpy_avx2(a + i, b + i, len - i, u);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void
+gf256_addrow_avx512(uint8_t *a, const uint8_t *b, size_t len) {
+  size_t i = 0;
+
+  for (; i + 64 <= len; i += 64) {
+    __m512i x = _mm512_loadu_si512((const void *)(b + i));
+    __m512i y = _mm512_loadu_si512((const void *)(a + i));
+    _mm512_storeu_si512((void *)(a + i), _mm512_xor_si512(y, x));
+  }
+  gf256_addrow_avx2(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void
+gf256_scal_avx512(uint8_t *a, size_t len, uint8_t u) {
+  __m512i lo =
+      _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)gf256_lo[u]));
+  __m512i hi =
+      _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)gf256_hi[u]));
+  __m512i mask = _mm512_set1_epi8(0x0f);
+  size_t i = 0;
+
+  for (; i + 64 <= len; i += 64) {
+    __m512i x = _mm512_loadu_si512((const void *)(a + i));
+    __m512i l = _mm512_shuffle_epi8(lo, _mm512_and_si512(x, mask));
+    __m512i h = _mm512_shuffle_epi8(
+        hi, _mm512_and_si512(_mm512_srli_epi64(x, 4), mask));
+    _mm512_storeu_si512((void *)(a + i), _mm512_xor_si512(l, h));
+  }
+  gf256_scal_avx2(a + i, len - i, u);
+}
+
+__attribute__((target("gfni,avx2"))) static void
+gf256_axpy_gfni(uint8_t *a, const uint8_t *b, size_t len, uint8_t u) {
+  __m256i m = _mm256_set1_epi64x((long long)gf256_affine[u]);
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(b + i));
+    __m256i y = _mm256_loadu_si256((const __m256i *)(a + i));
+    _mm256_storeu_si256(
+        (__m256i *)(a + i),
+        _mm256_xor_si256(y, _mm256_gf2p8affine_epi64_epi8(x, m, 0)));
+  }
+  gf256_axpy_ssse3(a + i, b + i, len - i, u);
+}
+
+__attribute__((target("gfni,avx2"))) static void
+gf256_scal_gfni(uint8_t *a, size_t len, uint8_t u) {
+  __m256i m = _mm256_set1_epi64x((long long)gf256_affine[u]);
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+    _mm256_storeu_si256((__m256i *)(a + i),
+                        _mm256_gf2p8affine_epi64_epi8(x, m, 0));
+  }
+  gf256_scal_ssse3(a + i, len - i, u);
+}
+
+__attribute__((target("gfni,avx512f,avx512bw"))) static void
+gf256_axpy_gfni512(uint8_t *a, const uint8_t *b, size_t len, uint8_t u) {
+  __m512i m = _mm512_set1_epi64((long long)gf256_affine[u]);
+  size_t i = 0;
+
+  for (; i + 64 <= len; i += 64) {
+    __m512i x = _mm512_loadu_si512((const void *)(b + i));
+    __m512i y = _mm512_loadu_si512((const void *)(a + i));
+    _mm512_storeu_si512(
+        (void *)(a + i),
+        _mm512_xor_si512(y, _mm512_gf2p8affine_epi64_epi8(x, m, 0)));
+  }
+  gf256_axpy_gfni(a + i, b + i, len - i, u);
+}
+
+__attribute__((target("gfni,avx512f,avx512bw"))) static void
+gf256_scal_gfni512(uint8_t *a, size_t len, uint8_t u) {
+  __m512i m = _mm512_set1_epi64((long long)gf256_affine[u]);
+  size_t i = 0;
+
+  for (; i + 64 <= len; i += 64) {
+    __m512i x = _mm512_loadu_si512((const void *)(a + i));
+    _mm512_storeu_si512((void *)(a + i),
+                        _mm512_gf2p8affine_epi64_epi8(x, m, 0));
+  }
+  gf256_scal_gfni(a + i, len - i, u);
+}
+
+static void gf256_tables(void) {
+  for (int u = 0; u < 256; u++) {
+    for (int n = 0; n < 16; n++) {
+      uint8_t high = n << 4;
+      gf256_lo[u][n] = OCTET_MUL(u, n);
+      gf256_hi[u][n] = OCTET_MUL(u, high);
+    }
+    /* row 7 - i of the matrix picks the input bits feeding output bit i */
+    uint64_t m = 0;
+    for (int i = 0; i < 8; i++) {
+      uint8_t row = 0;
+      for (int k = 0; k < 8; k++) {
+        uint8_t bit = 1 << k;
+        if ((OCTET_MUL(u, bit) >> i) & 1)
+          row |= 1 << k;
+      }
+      m |= (uint64_t)row << (8 * (7 - i));
+    }
+    gf256_affine[u] = m;
+  }
+}
+
+/* narrowest first, the widest the cpu has is used */
+static const struct gf256_kernels gf256_x86[] = {
+    {"ssse3", gf256_axpy_ssse3, gf256_addrow_ssse3, gf256_scal_ssse3},
+    {"avx2", gf256_axpy_avx2, gf256_addrow_avx2, gf256_scal_avx2},
+    {"gfni", gf256_axpy_gfni, gf256_addrow_avx2, gf256_scal_gfni},
+    {"avx512", gf256_axpy_avx512, gf256_addrow_avx512, gf256_scal_avx512},
+    {"gfni-avx512", gf256_axpy_gfni512, gf256_addrow_avx512,
+     gf256_scal_gfni512},
+};
+#define GF256_X86_COUNT (sizeof(gf256_x86) / sizeof(gf256_x86[0]))
+static bool gf256_x86_ok[GF256_X86_COUNT];
+
+/* runs before main, so the kernels never change while in use */
+__attribute__((constructor)) static void gf256_init(void) {
+  gf256_tables();
+  __builtin_cpu_init();
+  bool avx2 = __builtin_cpu_supports("avx2");
+  bool avx512 = __builtin_cpu_supports("avx512bw");
+  bool gfni = __builtin_cpu_supports("gfni");
+
+  gf256_x86_ok[0] = __builtin_cpu_supports("ssse3");
+  gf256_x86_ok[1] = avx2;
+  gf256_x86_ok[2] = gfni && avx2;
+  gf256_x86_ok[3] = avx512;
+  gf256_x86_ok[4] = gfni && avx512;
+  for (size_t idx = 0; idx < GF256_X86_COUNT; idx++) {
+    if (gf256_x86_ok[idx])
+      gf256 = gf256_x86[idx];
+  }
+}
+#endif
+
+void gf256_axpy(uint8_t *a, const uint8_t *b, size_t len, uint8_t u) {
+  if (u == 0)
+    return;
+  if (u == 1) {
+    gf256.addrow(a, b, len);
+  } else {
+    gf256.axpy(a, b, len, u);
+  }
+}
+
+void gf256_addrow(uint8_t *a, const uint8_t *b, size_t len) {
+  gf256.addrow(a, b, len);
+}
+
+void gf256_scal(uint8_t *a, size_t len, uint8_t u) {
+  if (u == 1)
+    return;
+  if (u == 0) {
+    memset(a, 0, len);
+  } else {
+    gf256.scal(a, len, u);
+  }
+}
+
+const char *gf256_kernel(void) { return gf256.name; }
+
+bool gf256_kernel_use(const char *name) {
+  struct gf256_kernels generic = {"generic", gf256_axpy_generic,
+                                  gf256_addrow_generic, gf256_scal_generic};
+
+  if (strcmp(name, generic.name) == 0) {
+    gf256 = generic;
+    return true;
+  }
+#ifdef GF256_X86
+  for (size_t idx = 0; idx < GF256_X86_COUNT; idx++) {
+    if (gf256_x86_ok[idx] && strcmp(name, gf256_x86[idx].name) == 0) {
+      gf256 = gf256_x86[idx];
+      return true;
+    }
+  }
+#endif
+  return false;
+}
@@ -0,0 +1,28 @@
+#ifndef NANORQ_GF256_H
+#define NANORQ_GF256_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * GF(256) row kernels for the solver's hot loops. the widest implementation
+ * the running cpu supports is picked once at startup, so one binary runs
+ * everywhere without -march=native.
+ */
+
+/* a += u * b */
+void gf256_axpy(uint8_t *a, const uint8_t *b, size_t len, uint8_t u);
+/* a += b */
+void gf256_addrow(uint8_t *a, const uint8_t *b, size_t len);
+/* a *= u */
+void gf256_scal(uint8_t *a, size_t len, uint8_t u);
+
+/* name of the implementation in use */
+const char *gf256_kernel(void);
+
+/* switches to the named implementation if the cpu supports it, for tests
+ * and benchmarks. must not run while any kernel is in use */
+bool gf256_kernel_use(const char *name);
+
+#endif
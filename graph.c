@@ -11,19 +11,39 @@ struct graph *graph_new(uint16_t size) {
 
   kv_init(g->edges);
   kv_resize(struct pair, g->edges, size);
+  kv_init(g->epoch);
+  kv_resize(uint32_t, g->epoch, size);
 
   for (int i = 0; i < size; i++) {
-    ASSIGN_PAIR(kv_A(g->edges, i), 1, i);
+    kv_A(g->epoch, i) = 0;
   }
+  g->cur_epoch = 1;
   g->max_edges = 1;
 
   return g;
 }
 
+void graph_reset(struct graph *g) {
+  g->cur_epoch++;
+  g->max_edges = 1;
+}
+
+static void graph_touch(struct graph *g, uint16_t id) {
+  if (kv_A(g->epoch, id) != g->cur_epoch) {
+    kv_A(g->epoch, id) = g->cur_epoch;
+    ASSIGN_PAIR(kv_A(g->edges, id), 1, id);
+  }
+}
+
 uint16_t graph_find(struct graph *g, uint16_t id) {
   uint16_t tmp = id;
-  while (kv_A(g->edges, tmp).second != tmp)
+  graph_touch(g, tmp);
+  while (kv_A(g->edges, tmp).second != tmp) {
+    /* path halving */
+    uint16_t parent = kv_A(g->edges, tmp).second;
+    kv_A(g->edges, tmp).second = kv_A(g->edges, parent).second;
     tmp = kv_A(g->edges, tmp).second;
+  }
   return tmp;
 }
 
@@ -31,18 +51,23 @@ void graph_link(struct graph *g, uint16_t node_a, uint16_t node_b) {
   uint16_t rep_a = graph_find(g, node_a);
   uint16_t rep_b = graph_find(g, node_b);
 
+  if (rep_a == rep_b)
+    return;
+
+  /* union by size, the larger component keeps its root */
+  if (kv_A(g->edges, rep_a).first < kv_A(g->edges, rep_b).first) {
+    uint16_t tmp = rep_a;
+    rep_a = rep_b;
+    rep_b = tmp;
+  }
+
   uint16_t s = kv_A(g->edges, rep_a).first + kv_A(g->edges, rep_b).first;
 
   ASSIGN_PAIR(kv_A(g->edges, rep_a), s, rep_a);
-  ASSIGN_PAIR(kv_A(g->edges, rep_b), s, rep_a);
-
-  if (node_a != rep_a)
-    ASSIGN_PAIR(kv_A(g->edges, node_a), s, rep_a);
-  if (node_b != rep_b)
-    ASSIGN_PAIR(kv_A(g->edges, node_b), s, rep_a);
+  kv_A(g->edges, rep_b).second = rep_a;
 
-  if (g->max_edges < kv_A(g->edges, rep_a).first) {
-    g->max_edges = kv_A(g->edges, rep_a).first;
+  if (g->max_edges < s) {
+    g->max_edges = s;
   }
 }
 
@@ -54,6 +79,7 @@ bool graph_is_max(struct graph *g, uint16_t id) {
 void graph_free(struct graph *g) {
   if (g) {
     kv_destroy(g->edges);
+    kv_destroy(g->epoch);
     free(g);
   }
 }
@@ -6,12 +6,20 @@
 
 #include "util.h"
 
+/*
+ * union-find over the columns of V, allocated once per solve. edges holds
+ * (component size, parent) per node; nodes whose epoch is stale count as
+ * singletons so graph_reset is O(1).
+ */
 struct graph {
   pair_vec edges;
+  kvec_t(uint32_t) epoch;
+  uint32_t cur_epoch;
   uint16_t max_edges;
 };
 
 struct graph *graph_new(uint16_t size);
+void graph_reset(struct graph *g);
 void graph_link(struct graph *g, uint16_t node_a, uint16_t node_b);
 bool graph_is_max(struct graph *g, uint16_t id);
 uint16_t graph_find(struct graph *g, uint16_t id);
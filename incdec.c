@@ -0,0 +1,139 @@
+#include <stdlib.h>
+
+#include <oblas.h>
+
+#include "gf256.h"
+#include "incdec.h"
+#include "precode.h"
+
+/* reduce the pending equation and, if it is independent, make it a pivot */
+static bool incdec_insert(struct incdec *inc, bool dzero) {
+  uint16_t L = inc->prm->L;
+  uint16_t T = inc->D.cols;
+  uint8_t *row = om_R(inc->row, 0);
+  int lead = -1;
+
+  if (dzero)
+    memset(om_R(inc->drow, 0), 0, T);
+
+  /* pivot rows carry no other pivot column, one pass is enough */
+  for (int col = 0; col < L; col++) {
+    uint8_t beta = row[col];
+    if (beta == 0)
+      continue;
+    if (!inc->pivot[col]) {
+      if (lead < 0)
+        lead = col;
+      continue;
+    }
+    gf256_axpy(om_R(inc->row, 0), om_R(inc->coef, col), L, beta);
+    if (!inc->dzero[col]) {
+      gf256_axpy(om_R(inc->drow, 0), om_R(inc->D, col), T, beta);
+      dzero = false;
+    }
+  }
+  if (lead < 0)
+    return false;
+
+  if (row[lead] != 1) {
+    uint8_t beta = OCTET_DIV(1, row[lead]);
+    gf256_scal(om_R(inc->row, 0), L, beta);
+    if (!dzero)
+      gf256_scal(om_R(inc->drow, 0), T, beta);
+  }
+
+  /* keep the system fully reduced, clear the new pivot column elsewhere */
+  for (int col = 0; col < L; col++) {
+    if (!inc->pivot[col])
+      continue;
+    uint8_t beta = om_A(inc->coef, col, lead);
+    if (beta == 0)
+      continue;
+    gf256_axpy(om_R(inc->coef, col), om_R(inc->row, 0), L, beta);
+    if (!dzero) {
+      gf256_axpy(om_R(inc->D, col), om_R(inc->drow, 0), T, beta);
+      inc->dzero[col] = 0;
+    }
+  }
+
+  ocopy(om_P(inc->coef), om_P(inc->row), lead, 0, L);
+  ocopy(om_P(inc->D), om_P(inc->drow), lead, 0, T);
+  inc->pivot[lead] = 1;
+  inc->dzero[lead] = dzero;
+  inc->rank++;
+  return true;
+}
+
+static void incdec_load_sparse(struct incdec *inc, const uint16_t *idxs,
+                               size_t len) {
+  memset(om_R(inc->row, 0), 0, inc->row.cols);
+  for (size_t idx = 0; idx < len; idx++) {
+    om_A(inc->row, 0, idxs[idx]) = 1;
+  }
+}
+
+struct incdec *incdec_new(struct pparams *prm, uint16_t num_symbols,
+                          uint16_t cols) {
+  struct incdec *inc = calloc(1, sizeof(struct incdec));
+  struct cmat A = {0};
+
+  inc->prm = prm;
+  inc->coef = (octmat)OM_INITIAL;
+  inc->D = (octmat)OM_INITIAL;
+  inc->row = (octmat)OM_INITIAL;
+  inc->drow = (octmat)OM_INITIAL;
+  om_resize(&inc->coef, prm->L, prm->L);
+  om_resize(&inc->D, prm->L, cols);
+  om_resize(&inc->row, 1, prm->L);
+  om_resize(&inc->drow, 1, cols);
+  inc->pivot = calloc(prm->L, sizeof(uint8_t));
+  inc->dzero = calloc(prm->L, sizeof(uint8_t));
+
+  /* the LDPC and HDPC constraints and the padding symbols are known zeros */
+  precode_matrix_gen(prm, &A, 0);
+  for (int row = 0; row < prm->S + prm->H; row++) {
+    if (row < prm->S) {
+      uint16_vec *idxs = &A.sp->idxs[row];
+      incdec_load_sparse(inc, idxs->a, kv_size(*idxs));
+    } else {
+      ocopy(om_P(inc->row), om_P(A.hdpc), 0, row - prm->S, prm->L);
+    }
+    incdec_insert(inc, true);
+  }
+  precode_matrix_free(&A);
+
+  for (uint32_t isi = num_symbols; isi < prm->K_padded; isi++) {
+    struct params_idxs t = params_get_idxs(prm, isi);
+    incdec_load_sparse(inc, t.idx, t.len);
+    incdec_insert(inc, true);
+  }
+
+  return inc;
+}
+
+bool incdec_add(struct incdec *inc, uint32_t isi, const uint8_t *data) {
+  if (incdec_complete(inc))
+    return false;
+
+  struct params_idxs t = params_get_idxs(inc->prm, isi);
+  incdec_load_sparse(inc, t.idx, t.len);
+  memcpy(om_R(inc->drow, 0), data, inc->drow.cols);
+
+  return incdec_insert(inc, false);
+}
+
+bool incdec_complete(struct incdec *inc) {
+  return inc->rank == inc->prm->L;
+}
+
+void incdec_free(struct incdec *inc) {
+  if (inc) {
+    om_destroy(&inc->coef);
+    om_destroy(&inc->D);
+    om_destroy(&inc->row);
+    om_destroy(&inc->drow);
+    free(inc->pivot);
+    free(inc->dzero);
+    free(inc);
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef NANORQ_INCDEC_H
+#define NANORQ_INCDEC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "params.h"
+
+/*
+ * on the fly gaussian elimination: every equation is reduced against the
+ * pivots found so far as it arrives, and the system is kept fully reduced,
+ * so once L independent equations are in D holds the intermediate symbols
+ * and no solve is left to do. costs an L x L coefficient matrix, meant for
+ * latency sensitive decoders of moderate K.
+ */
+struct incdec {
+  struct pparams *prm;
+  uint16_t rank;
+  octmat coef;    /* row c is the equation whose pivot is column c */
+  octmat D;       /* symbols of those equations */
+  uint8_t *pivot; /* column c has a pivot */
+  uint8_t *dzero; /* row c of D is still all zeros */
+  octmat row;     /* equation being reduced */
+  octmat drow;
+};
+
+struct incdec *incdec_new(struct pparams *prm, uint16_t num_symbols,
+                          uint16_t cols);
+bool incdec_add(struct incdec *inc, uint32_t isi, const uint8_t *data);
+bool incdec_complete(struct incdec *inc);
+void incdec_free(struct incdec *inc);
+
+#endif
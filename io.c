@@ -1,77 +1,119 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "io.h"
+#include "kvec.h"
 
+/* files are used through their descriptor so the positional calls need no
+ * shared position and no stdio buffer can go stale under them */
 struct fileioctx {
   struct ioctx io;
-  FILE *fp;
+  int fd;
 };
 
+static size_t fileio_read_at(struct ioctx *io, void *buf, size_t len,
+                             uint64_t offset) {
+  struct fileioctx *fio = (struct fileioctx *)io;
+  size_t got = 0;
+  while (got < len) {
+    ssize_t ret = pread(fio->fd, (uint8_t *)buf + got, len - got, offset + got);
+    if (ret <= 0)
+      break;
+    got += ret;
+  }
+  return got;
+}
+
+static size_t fileio_write_at(struct ioctx *io, const void *buf, size_t len,
+                              uint64_t offset) {
+  struct fileioctx *fio = (struct fileioctx *)io;
+  size_t put = 0;
+  while (put < len) {
+    ssize_t ret =
+        pwrite(fio->fd, (const uint8_t *)buf + put, len - put, offset + put);
+    if (ret <= 0)
+      break;
+    put += ret;
+  }
+  return put;
+}
+
 static size_t fileio_read(struct ioctx *io, void *buf, int len) {
   struct fileioctx *fio = (struct fileioctx *)io;
-  return fread(buf, 1, len, fio->fp);
+  ssize_t ret = read(fio->fd, buf, len);
+  return (ret > 0) ? ret : 0;
 }
 
 static size_t fileio_write(struct ioctx *io, const void *buf, int len) {
   struct fileioctx *fio = (struct fileioctx *)io;
-  return fwrite(buf, 1, len, fio->fp);
+  ssize_t ret = write(fio->fd, buf, len);
+  return (ret > 0) ? ret : 0;
 }
 
 static int fileio_seek(struct ioctx *io, const int offset) {
   struct fileioctx *fio = (struct fileioctx *)io;
-  return (fseek(fio->fp, offset, SEEK_SET) == 0);
+  return (lseek(fio->fd, offset, SEEK_SET) == offset);
 }
 
 static long fileio_tell(struct ioctx *io) {
   struct fileioctx *fio = (struct fileioctx *)io;
-  return ftell(fio->fp);
+  return lseek(fio->fd, 0, SEEK_CUR);
 }
 
 static void fileio_destroy(struct ioctx *io) {
   struct fileioctx *fio = (struct fileioctx *)io;
-  fclose(fio->fp);
+  close(fio->fd);
   free(fio);
   return;
 }
 
 static size_t fileio_size(struct ioctx *io) {
   struct fileioctx *fio = (struct fileioctx *)io;
-  long ret = 0;
-  long pos = ftell(fio->fp);
-  fseek(fio->fp, 0, SEEK_END);
-  ret = ftell(fio->fp);
-  fseek(fio->fp, pos, SEEK_SET);
-  return ret;
+  struct stat st;
+  if (fstat(fio->fd, &st) != 0)
+    return 0;
+  return st.st_size;
 }
 
-struct ioctx *ioctx_from_file(const char *fn, int t) {
-  struct fileioctx *ret = NULL;
+static int fileio_open(const char *fn, int t) {
+  if (t)
+    return open(fn, O_RDONLY);
+  return open(fn, O_RDWR | O_CREAT | O_TRUNC, 0666); // create decoder
+}
 
-  FILE *fp;
+static void fileio_init(struct fileioctx *fio, int fd) {
+  fio->fd = fd;
 
-  if (t) {
-    fp = fopen(fn, "r");
-  } else {
-    fp = fopen(fn, "w+"); // create decoder
-  }
+  fio->io.read = fileio_read;
+  fio->io.write = fileio_write;
+  fio->io.seek = fileio_seek;
+  fio->io.size = fileio_size;
+  fio->io.tell = fileio_tell;
+  fio->io.destroy = fileio_destroy;
+  fio->io.seekable = true;
+  fio->io.read_at = fileio_read_at;
+  fio->io.write_at = fileio_write_at;
+}
 
-  if (!fp)
+struct ioctx *ioctx_from_file(const char *fn, int t) {
+  struct fileioctx *ret = NULL;
+
+  int fd = fileio_open(fn, t);
+  if (fd < 0)
     return NULL;
 
   ret = calloc(1, sizeof(struct fileioctx));
-  ret->fp = fp;
-
-  ret->io.read = fileio_read;
-  ret->io.write = fileio_write;
-  ret->io.seek = fileio_seek;
-  ret->io.size = fileio_size;
-  ret->io.tell = fileio_tell;
-  ret->io.destroy = fileio_destroy;
-  ret->io.seekable = true;
+  fileio_init(ret, fd);
 
   return (struct ioctx *)ret;
 }
@@ -83,22 +125,42 @@ struct memioctx {
   size_t size;
 };
 
-static size_t memio_read(struct ioctx *io, void *buf, int len) {
+static size_t memio_read_at(struct ioctx *io, void *buf, size_t len,
+                            uint64_t offset) {
   struct memioctx *mio = (struct memioctx *)io;
-  if (mio->pos + len > mio->size)
+  if (offset >= mio->size)
     return 0;
-  memcpy(buf, mio->ptr + mio->pos, len);
+  if (len > mio->size - offset)
+    len = mio->size - offset;
+  memcpy(buf, mio->ptr + offset, len);
   return len;
 }
 
-static size_t memio_write(struct ioctx *io, const void *buf, int len) {
+static size_t memio_write_at(struct ioctx *io, const void *buf, size_t len,
+                             uint64_t offset) {
   struct memioctx *mio = (struct memioctx *)io;
-  if (mio->pos + len > mio->size)
+  if (offset >= mio->size)
     return 0;
-  memcpy(mio->ptr + mio->pos, buf, len);
+  if (len > mio->size - offset)
+    len = mio->size - offset;
+  memcpy(mio->ptr + offset, buf, len);
   return len;
 }
 
+static size_t memio_read(struct ioctx *io, void *buf, int len) {
+  struct memioctx *mio = (struct memioctx *)io;
+  size_t got = memio_read_at(io, buf, len, mio->pos);
+  mio->pos += got;
+  return got;
+}
+
+static size_t memio_write(struct ioctx *io, const void *buf, int len) {
+  struct memioctx *mio = (struct memioctx *)io;
+  size_t put = memio_write_at(io, buf, len, mio->pos);
+  mio->pos += put;
+  return put;
+}
+
 static int memio_seek(struct ioctx *io, const int offset) {
   struct memioctx *mio = (struct memioctx *)io;
   if (offset >= mio->size)
@@ -112,6 +174,13 @@ static long memio_tell(struct ioctx *io) {
   return mio->pos;
 }
 
+static const void *memio_map(struct ioctx *io, uint64_t offset, size_t len) {
+  struct memioctx *mio = (struct memioctx *)io;
+  if (offset > mio->size || len > mio->size - offset)
+    return NULL;
+  return mio->ptr + offset;
+}
+
 static void memio_destroy(struct ioctx *io) {
   struct memioctx *mio = (struct memioctx *)io;
   free(mio);
@@ -138,6 +207,539 @@ struct ioctx *ioctx_from_mem(const uint8_t *ptr, size_t sz) {
   ret->io.tell = memio_tell;
   ret->io.destroy = memio_destroy;
   ret->io.seekable = true;
+  ret->io.map = memio_map;
+  ret->io.read_at = memio_read_at;
+  ret->io.write_at = memio_write_at;
+
+  return (struct ioctx *)ret;
+}
+
+/*
+ * read only mapping of a file, reads are served from the page cache and
+ * source symbols can be used in place. nanorq asks for each source block
+ * to be read ahead before solving it. nanorq_encode_pipeline drops its
+ * pages once the block is sent, from the mapping and, where they are clean,
+ * from the page cache, so a large input never has to be resident at once.
+ */
+struct mmapioctx {
+  struct memioctx mem;
+  size_t page;
+  int fd; /* kept for page cache advice */
+};
+
+static void mmapio_advise(struct ioctx *io, uint64_t offset, size_t len,
+                          int advice) {
+  struct mmapioctx *mmio = (struct mmapioctx *)io;
+  uint64_t start = offset - offset % mmio->page;
+
+  if (offset >= mmio->mem.size)
+    return;
+  if (len > mmio->mem.size - offset)
+    len = mmio->mem.size - offset;
+  madvise(mmio->mem.ptr + start, len + (offset - start), advice);
+}
+
+static void mmapio_prefetch(struct ioctx *io, uint64_t offset, size_t len) {
+  mmapio_advise(io, offset, len, MADV_WILLNEED);
+}
+
+static void mmapio_release(struct ioctx *io, uint64_t offset, size_t len) {
+  struct mmapioctx *mmio = (struct mmapioctx *)io;
+
+  /* unmapping the pages alone leaves them cached, and counted, until the
+   * kernel needs the memory */
+  mmapio_advise(io, offset, len, MADV_DONTNEED);
+  posix_fadvise(mmio->fd, offset, len, POSIX_FADV_DONTNEED);
+}
+
+static size_t mmapio_write(struct ioctx *io, const void *buf, int len) {
+  return 0;
+}
+
+static void mmapio_destroy(struct ioctx *io) {
+  struct mmapioctx *mmio = (struct mmapioctx *)io;
+  if (mmio->mem.size > 0)
+    munmap(mmio->mem.ptr, mmio->mem.size);
+  close(mmio->fd);
+  free(mmio);
+}
+
+struct ioctx *ioctx_from_mmap(const char *fn) {
+  struct mmapioctx *ret = NULL;
+  struct stat st;
+  void *ptr = NULL;
+
+  int fd = open(fn, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+  if (st.st_size > 0) {
+    ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+      close(fd);
+      return NULL;
+    }
+    madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+  }
+
+  ret = calloc(1, sizeof(struct mmapioctx));
+  ret->mem.ptr = ptr;
+  ret->mem.pos = 0;
+  ret->mem.size = st.st_size;
+  ret->page = sysconf(_SC_PAGESIZE);
+  ret->fd = fd;
+
+  ret->mem.io.read = memio_read;
+  ret->mem.io.write = mmapio_write;
+  ret->mem.io.seek = memio_seek;
+  ret->mem.io.size = memio_size;
+  ret->mem.io.tell = memio_tell;
+  ret->mem.io.destroy = mmapio_destroy;
+  ret->mem.io.seekable = true;
+  ret->mem.io.map = memio_map;
+  ret->mem.io.read_at = memio_read_at;
+  ret->mem.io.prefetch = mmapio_prefetch;
+  ret->mem.io.release = mmapio_release;
+
+  return (struct ioctx *)ret;
+}
+
+/*
+ * file io through an io_uring. prefetch queues reads of the hinted range
+ * into windows that read_at is then served from, so nanorq can have the
+ * next block read while it solves the current one. writes are copied,
+ * coalesced while contiguous and queued, write_at returns once they are
+ * queued and destroy waits for them. a ring that can't be set up leaves a
+ * plain file ioctx.
+ */
+#define URING_ENTRIES 64
+#define URING_CHUNK (4 << 20)
+#define URING_READAHEAD (128 << 20)
+#define URING_WRITEBEHIND (64 << 20)
+
+struct uring_buf {
+  uint64_t offset;
+  size_t len; /* bytes to transfer, the bytes read once a read is done */
+  size_t cap;
+  uint8_t *data;
+  bool write;
+  bool pending;
+  bool dropped;
+};
+
+struct uringioctx {
+  struct fileioctx file;
+  pthread_mutex_t lock; /* guards everything below */
+  int ring;
+  unsigned entries;
+  unsigned queued;   /* in the sq, not yet taken by the kernel */
+  unsigned inflight; /* queued or taken, completion not reaped */
+  void *sq_ring, *cq_ring;
+  size_t sq_ring_len, cq_ring_len;
+  unsigned *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  kvec_t(struct uring_buf *) reads;
+  size_t read_bytes;
+  struct uring_buf *staged; /* write being coalesced, not yet queued */
+  size_t write_bytes;
+  bool failed; /* a write was lost, reported by flush */
+  bool broken; /* entering the ring failed, io is done synchronously */
+};
+
+static bool uring_setup(struct uringioctx *u) {
+  struct io_uring_params p;
+
+  memset(&p, 0, sizeof(p));
+  u->ring = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+  if (u->ring < 0)
+    return false;
+
+  u->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  u->cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  u->sq_ring = mmap(NULL, u->sq_ring_len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, u->ring, IORING_OFF_SQ_RING);
+  u->cq_ring = mmap(NULL, u->cq_ring_len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, u->ring, IORING_OFF_CQ_RING);
+  u->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring,
+                 IORING_OFF_SQES);
+  if (u->sq_ring == MAP_FAILED || u->cq_ring == MAP_FAILED ||
+      u->sqes == MAP_FAILED) {
+    if (u->sq_ring != MAP_FAILED)
+      munmap(u->sq_ring, u->sq_ring_len);
+    if (u->cq_ring != MAP_FAILED)
+      munmap(u->cq_ring, u->cq_ring_len);
+    if (u->sqes != MAP_FAILED)
+      munmap(u->sqes, p.sq_entries * sizeof(struct io_uring_sqe));
+    close(u->ring);
+    return false;
+  }
+
+  u->entries = p.sq_entries;
+  u->sq_tail = (unsigned *)((uint8_t *)u->sq_ring + p.sq_off.tail);
+  u->sq_mask = (unsigned *)((uint8_t *)u->sq_ring + p.sq_off.ring_mask);
+  u->sq_array = (unsigned *)((uint8_t *)u->sq_ring + p.sq_off.array);
+  u->cq_head = (unsigned *)((uint8_t *)u->cq_ring + p.cq_off.head);
+  u->cq_tail = (unsigned *)((uint8_t *)u->cq_ring + p.cq_off.tail);
+  u->cq_mask = (unsigned *)((uint8_t *)u->cq_ring + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)((uint8_t *)u->cq_ring + p.cq_off.cqes);
+  return true;
+}
+
+static void uring_free(struct uring_buf *b) {
+  free(b->data);
+  free(b);
+}
+
+/* takes read window i out of the list, a pending one is freed once it
+ * completes */
+static void uring_drop(struct uringioctx *u, size_t i) {
+  struct uring_buf *b = kv_A(u->reads, i);
+
+  kv_A(u->reads, i) = kv_A(u->reads, kv_size(u->reads) - 1);
+  kv_size(u->reads)--;
+  u->read_bytes -= b->cap;
+  if (b->pending) {
+    b->dropped = true;
+  } else {
+    uring_free(b);
+  }
+}
+
+/* takes a read window out of the ones read_at is served from */
+static void uring_unlist(struct uringioctx *u, struct uring_buf *b) {
+  for (size_t i = 0; i < kv_size(u->reads); i++) {
+    if (kv_A(u->reads, i) == b) {
+      uring_drop(u, i);
+      return;
+    }
+  }
+}
+
+/* short transfers are finished synchronously, a failed write fails all
+ * later ones */
+static void uring_complete(struct uringioctx *u, struct uring_buf *b,
+                           int res) {
+  size_t done = (res > 0) ? res : 0;
+
+  b->pending = false;
+  u->inflight--;
+  if (b->write) {
+    if (res >= 0 && done < b->len)
+      done += fileio_write_at(&u->file.io, b->data + done, b->len - done,
+                              b->offset + done);
+    if (done < b->len)
+      u->failed = true;
+    u->write_bytes -= b->cap;
+    uring_free(b);
+    return;
+  }
+  if (res >= 0 && done < b->len)
+    done += fileio_read_at(&u->file.io, b->data + done, b->len - done,
+                           b->offset + done);
+  b->len = done;
+  if (b->dropped) {
+    uring_free(b);
+  } else if (res < 0) {
+    /* read_at goes to the file for the range instead */
+    uring_unlist(u, b);
+  }
+}
+
+/* hands queued entries to the kernel, waits for wait completions and reaps
+ * all there are. returns false once the ring is broken, entries still
+ * pending then never complete */
+static bool uring_enter(struct uringioctx *u, unsigned wait) {
+  unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+
+  if (u->broken)
+    return false;
+  int ret = syscall(__NR_io_uring_enter, u->ring, u->queued, wait, flags,
+                    NULL, 0);
+  if (ret < 0 && errno != EINTR) {
+    /* whether the pending writes landed is unknown */
+    u->broken = true;
+    u->failed = true;
+    return false;
+  }
+  if (ret > 0)
+    u->queued -= ret;
+
+  unsigned head = *u->cq_head;
+  unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+    uring_complete(u, (struct uring_buf *)(uintptr_t)cqe->user_data,
+                   cqe->res);
+  }
+  __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+  return true;
+}
+
+static void uring_submit(struct uringioctx *u, struct uring_buf *b) {
+  while (u->inflight >= u->entries && uring_enter(u, 1))
+    ;
+  if (u->broken) {
+    b->pending = true;
+    u->inflight++;
+    uring_complete(u, b, 0);
+    return;
+  }
+
+  unsigned tail = *u->sq_tail;
+  unsigned idx = tail & *u->sq_mask;
+  struct io_uring_sqe *sqe = &u->sqes[idx];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = b->write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd = u->file.fd;
+  sqe->off = b->offset;
+  sqe->addr = (uintptr_t)b->data;
+  sqe->len = b->len;
+  sqe->user_data = (uintptr_t)b;
+  u->sq_array[idx] = idx;
+  __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  b->pending = true;
+  u->queued++;
+  u->inflight++;
+  uring_enter(u, 0);
+}
+
+/* queues the staged write and waits for all writes to land */
+static void uring_flush(struct uringioctx *u) {
+  if (u->staged) {
+    uring_submit(u, u->staged);
+    u->staged = NULL;
+  }
+  while (u->write_bytes > 0 && uring_enter(u, 1))
+    ;
+}
+
+/* the read window holding offset, or the first one after it */
+static struct uring_buf *uring_window(struct uringioctx *u, uint64_t offset,
+                                      uint64_t *next) {
+  for (size_t i = 0; i < kv_size(u->reads); i++) {
+    struct uring_buf *b = kv_A(u->reads, i);
+    if (b->offset <= offset && offset < b->offset + b->len)
+      return b;
+    if (b->offset > offset && b->offset < *next)
+      *next = b->offset;
+  }
+  return NULL;
+}
+
+static size_t uringio_read_at(struct ioctx *io, void *buf, size_t len,
+                              uint64_t offset) {
+  struct uringioctx *u = (struct uringioctx *)io;
+  size_t got = 0;
+
+  pthread_mutex_lock(&u->lock);
+  if (u->write_bytes > 0)
+    uring_flush(u);
+  while (got < len) {
+    uint64_t pos = offset + got, next = offset + len;
+    struct uring_buf *b = u->broken ? NULL : uring_window(u, pos, &next);
+    if (b == NULL) {
+      size_t want = next - pos;
+      size_t n = fileio_read_at(io, (uint8_t *)buf + got, want, pos);
+      got += n;
+      if (n < want)
+        break;
+      continue;
+    }
+    if (b->pending) {
+      /* the window may come back short or failed and freed, so wait for
+       * any completion and look it up again */
+      uring_enter(u, 1);
+      continue;
+    }
+    size_t n = b->offset + b->len - pos;
+    if (n > len - got)
+      n = len - got;
+    memcpy((uint8_t *)buf + got, b->data + (pos - b->offset), n);
+    got += n;
+  }
+  pthread_mutex_unlock(&u->lock);
+  return got;
+}
+
+static size_t uringio_write_at(struct ioctx *io, const void *buf, size_t len,
+                               uint64_t offset) {
+  struct uringioctx *u = (struct uringioctx *)io;
+  struct uring_buf *b;
+
+  pthread_mutex_lock(&u->lock);
+  if (u->failed) {
+    pthread_mutex_unlock(&u->lock);
+    return 0;
+  }
+  /* windows read before the write would serve the old bytes */
+  for (size_t i = 0; i < kv_size(u->reads);) {
+    struct uring_buf *w = kv_A(u->reads, i);
+    if (w->offset < offset + len && offset < w->offset + w->cap) {
+      uring_drop(u, i);
+    } else {
+      i++;
+    }
+  }
+  b = u->staged;
+  if (b && (offset != b->offset + b->len || len > b->cap - b->len)) {
+    uring_submit(u, b);
+    b = u->staged = NULL;
+  }
+  if (b == NULL) {
+    size_t cap = (len > URING_CHUNK) ? len : URING_CHUNK;
+    b = calloc(1, sizeof(struct uring_buf));
+    if (b == NULL || (b->data = malloc(cap)) == NULL) {
+      free(b);
+      u->failed = true;
+      pthread_mutex_unlock(&u->lock);
+      return 0;
+    }
+    b->offset = offset;
+    b->cap = cap;
+    b->write = true;
+    u->write_bytes += b->cap;
+    u->staged = b;
+  }
+  memcpy(b->data + b->len, buf, len);
+  b->len += len;
+  if (b->len == b->cap) {
+    uring_submit(u, b);
+    u->staged = NULL;
+  }
+  while (u->write_bytes > URING_WRITEBEHIND && uring_enter(u, 1))
+    ;
+  pthread_mutex_unlock(&u->lock);
+  return len;
+}
+
+/* queues reads of the range in chunks, up to URING_READAHEAD bytes of
+ * windows are kept */
+static void uringio_prefetch(struct ioctx *io, uint64_t offset, size_t len) {
+  struct uringioctx *u = (struct uringioctx *)io;
+  uint64_t size = fileio_size(io);
+  uint64_t end = (offset + len < size) ? offset + len : size;
+
+  pthread_mutex_lock(&u->lock);
+  for (uint64_t pos = offset; pos < end && !u->broken; pos += URING_CHUNK) {
+    uint64_t next = end;
+    size_t n = (end - pos < URING_CHUNK) ? end - pos : URING_CHUNK;
+    if (uring_window(u, pos, &next))
+      continue;
+    if (u->read_bytes + n > URING_READAHEAD)
+      break;
+
+    struct uring_buf *b = calloc(1, sizeof(struct uring_buf));
+    if (b == NULL || (b->data = malloc(n)) == NULL) {
+      free(b);
+      break;
+    }
+    b->offset = pos;
+    b->len = b->cap = n;
+    kv_push(struct uring_buf *, u->reads, b);
+    u->read_bytes += n;
+    uring_submit(u, b);
+  }
+  pthread_mutex_unlock(&u->lock);
+}
+
+/* drops the windows inside the range, pending ones once they complete */
+static void uringio_release(struct ioctx *io, uint64_t offset, size_t len) {
+  struct uringioctx *u = (struct uringioctx *)io;
+
+  pthread_mutex_lock(&u->lock);
+  for (size_t i = 0; i < kv_size(u->reads);) {
+    struct uring_buf *b = kv_A(u->reads, i);
+    if (b->offset < offset || b->offset + b->len > offset + len) {
+      i++;
+      continue;
+    }
+    uring_drop(u, i);
+  }
+  pthread_mutex_unlock(&u->lock);
+}
+
+static size_t uringio_write(struct ioctx *io, const void *buf, int len) {
+  struct uringioctx *u = (struct uringioctx *)io;
+
+  pthread_mutex_lock(&u->lock);
+  uring_flush(u);
+  size_t put = fileio_write(io, buf, len);
+  pthread_mutex_unlock(&u->lock);
+  return put;
+}
+
+static size_t uringio_size(struct ioctx *io) {
+  struct uringioctx *u = (struct uringioctx *)io;
+
+  pthread_mutex_lock(&u->lock);
+  uring_flush(u);
+  pthread_mutex_unlock(&u->lock);
+  return fileio_size(io);
+}
+
+static bool uringio_flush(struct ioctx *io) {
+  struct uringioctx *u = (struct uringioctx *)io;
+
+  pthread_mutex_lock(&u->lock);
+  uring_flush(u);
+  bool ok = !u->failed;
+  pthread_mutex_unlock(&u->lock);
+  return ok;
+}
+
+static void uringio_destroy(struct ioctx *io) {
+  struct uringioctx *u = (struct uringioctx *)io;
+
+  uring_flush(u);
+  while (u->inflight > 0 && uring_enter(u, 1))
+    ;
+  /* the kernel may still fill the pending windows of a broken ring */
+  for (size_t i = 0; i < kv_size(u->reads); i++) {
+    if (!kv_A(u->reads, i)->pending)
+      uring_free(kv_A(u->reads, i));
+  }
+  kv_destroy(u->reads);
+
+  munmap(u->sqes, u->entries * sizeof(struct io_uring_sqe));
+  munmap(u->sq_ring, u->sq_ring_len);
+  munmap(u->cq_ring, u->cq_ring_len);
+  close(u->ring);
+  pthread_mutex_destroy(&u->lock);
+  fileio_destroy(io);
+}
+
+struct ioctx *ioctx_from_uring(const char *fn, int t) {
+  struct uringioctx *ret = NULL;
+
+  int fd = fileio_open(fn, t);
+  if (fd < 0)
+    return NULL;
+
+  ret = calloc(1, sizeof(struct uringioctx));
+  fileio_init(&ret->file, fd);
+  if (!uring_setup(ret))
+    return (struct ioctx *)ret;
+
+  pthread_mutex_init(&ret->lock, NULL);
+  kv_init(ret->reads);
+
+  ret->file.io.write = uringio_write;
+  ret->file.io.size = uringio_size;
+  ret->file.io.flush = uringio_flush;
+  ret->file.io.destroy = uringio_destroy;
+  ret->file.io.prefetch = uringio_prefetch;
+  ret->file.io.release = uringio_release;
+  ret->file.io.read_at = uringio_read_at;
+  ret->file.io.write_at = uringio_write_at;
 
   return (struct ioctx *)ret;
 }
@@ -2,8 +2,16 @@
 #define NANORQ_IOCTX_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/*
+ * read_at and write_at are positional with 64-bit offsets and share no
+ * position, so any number of threads can use one ioctx through them. they
+ * transfer fewer bytes only at the end of the data. nanorq prefers them and
+ * falls back to seek with read or write, which is limited to 2 GB offsets,
+ * when they are NULL.
+ */
 struct ioctx {
   size_t (*read)(struct ioctx *, void *, int);
   size_t (*write)(struct ioctx *, const void *, int);
@@ -12,9 +20,23 @@ struct ioctx {
   long (*tell)(struct ioctx *);
   void (*destroy)(struct ioctx *);
   bool seekable;
+  /* points at len bytes from offset in place, NULL if io is not in memory */
+  const void *(*map)(struct ioctx *, uint64_t, size_t);
+  /* optional hints that a range is about to be read or won't be again */
+  void (*prefetch)(struct ioctx *, uint64_t, size_t);
+  void (*release)(struct ioctx *, uint64_t, size_t);
+  size_t (*read_at)(struct ioctx *, void *, size_t, uint64_t);
+  size_t (*write_at)(struct ioctx *, const void *, size_t, uint64_t);
+  /* waits for writes still in flight, false if any was lost. NULL when
+   * writes are done by the time they return */
+  bool (*flush)(struct ioctx *);
 };
 
 struct ioctx *ioctx_from_file(const char *fn, int t);
 struct ioctx *ioctx_from_mem(const uint8_t *ptr, size_t t);
+struct ioctx *ioctx_from_mmap(const char *fn);
+/* file io through io_uring, reads hinted with prefetch and writes are done
+ * in the background. falls back to ioctx_from_file's io without a ring */
+struct ioctx *ioctx_from_uring(const char *fn, int t);
 
 #endif
@@ -1,10 +1,14 @@
+#include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 
+#include "incdec.h"
 #include "nanorq.h"
+#include "pool.h"
 #include "precode.h"
 
 struct oti_common {
-  size_t F;   /* input size in bytes */
+  uint64_t F; /* input size in bytes */
   uint16_t T; /* the symbol size in octets, which MUST be a multiple of Al */
   uint8_t Al; /* byte alignment, 0 < Al <= 8, 4 is recommended */
 };
@@ -23,7 +27,7 @@ struct partition {
 };
 
 struct source_block {
-  size_t sbloc;
+  uint64_t sbloc; /* in Al units */
   size_t part_tot;
   struct partition part;
   uint16_t al;
@@ -35,6 +39,7 @@ struct encoder_core {
   uint16_t symbol_size;
   struct pparams prm;
   octmat symbolmat;
+  struct params_cache *cache; /* tuples of repair symbols, may be NULL */
 };
 
 struct decoder_core {
@@ -45,6 +50,7 @@ struct decoder_core {
   octmat symbolmat;
   repair_vec repair_bin;
   struct bitmask *mask;
+  struct incdec *inc; /* set when decoding incrementally */
 };
 
 struct nanorq {
@@ -56,6 +62,9 @@ struct nanorq {
 
   struct encoder_core *encoders[Z_max];
   struct decoder_core *decoders[Z_max];
+  bool incremental;
+  struct pool *pool;    /* shares out a single block's solve, may be NULL */
+  uint32_t tuple_cache; /* slots of each block's tuple cache, 0 for none */
 };
 
 static struct oti_scheme gen_scheme_specific(struct oti_common *common,
@@ -79,12 +88,52 @@ static struct oti_scheme gen_scheme_specific(struct oti_common *common,
     Kn = div_ceil(ret.Kt, Z);
   }
   ret.Z = div_ceil(ret.Kt, Kn);
-  // disable interleaving
+  // one sub-block, nanorq_encoder_new_ws picks N from a memory budget
   ret.N = 1;
 
   return ret;
 }
 
+/* largest K' whose sub-blocks of n fit in WS bytes, KL(n) in RFC 6330 */
+static uint16_t max_block_symbols(uint16_t T, uint32_t WS, uint8_t Al,
+                                  uint16_t n) {
+  uint32_t limit = WS / (Al * div_ceil(T / Al, n));
+  uint16_t ret = 0;
+
+  for (int idx = 0; idx < K_padded_size && K_padded[idx] <= limit; idx++) {
+    ret = K_padded[idx];
+  }
+  return ret;
+}
+
+/*
+ * RFC 6330 4.4.1.2: fewest blocks for which a block of N sub-blocks of at
+ * least SS * Al bytes each fits in the working memory WS
+ */
+static struct oti_scheme gen_scheme_ws(struct oti_common *common, uint16_t SS,
+                                       uint32_t WS) {
+  struct oti_scheme ret = {0};
+  ret.Kt = div_ceil(common->F, common->T);
+
+  uint16_t N_max = SS ? common->T / (SS * common->Al) : 0;
+  uint16_t KL_max = N_max ? max_block_symbols(common->T, WS, common->Al, N_max)
+                          : 0;
+  if (KL_max == 0)
+    return ret;
+
+  ret.Z = div_ceil(ret.Kt, KL_max);
+  if (ret.Z == 0)
+    return ret;
+  for (uint16_t n = 1; n <= N_max; n++) {
+    if (div_ceil(ret.Kt, ret.Z) <=
+        max_block_symbols(common->T, WS, common->Al, n)) {
+      ret.N = n;
+      break;
+    }
+  }
+  return ret;
+}
+
 static struct partition fill_partition(size_t I, uint16_t J) {
   struct partition p = {0, 0, 0, 0};
   if (J == 0)
@@ -108,33 +157,67 @@ static struct source_block get_source_block(nanorq *rq, uint8_t sbn,
   ret.part_tot = rq->sub_part.IL * rq->sub_part.JL;
 
   if (sbn < rq->src_part.JL) {
-    ret.sbloc = sbn * rq->src_part.IL * symbol_size;
+    ret.sbloc = (uint64_t)sbn * rq->src_part.IL * symbol_size;
   } else if (sbn - rq->src_part.JL < rq->src_part.JS) {
-    ret.sbloc = (rq->src_part.IL * rq->src_part.JL) * symbol_size +
-                (sbn - rq->src_part.JL) * rq->src_part.IS * symbol_size;
+    ret.sbloc = (uint64_t)rq->src_part.IL * rq->src_part.JL * symbol_size +
+                (uint64_t)(sbn - rq->src_part.JL) * rq->src_part.IS *
+                    symbol_size;
   }
 
   return ret;
 }
 
-static size_t get_symbol_offset(struct source_block *blk, size_t pos,
-                                uint16_t K, uint32_t symbol_id) {
-  size_t i;
+static uint64_t get_symbol_offset(struct source_block *blk, size_t pos,
+                                  uint16_t K, uint32_t symbol_id) {
+  uint64_t i;
 
   if (pos < blk->part_tot) {
-    size_t sub_blk_id = pos / blk->part.IL;
-    i = blk->sbloc + sub_blk_id * K * blk->part.IL + symbol_id * blk->part.IL +
-        pos % blk->part.IL;
+    uint64_t sub_blk_id = pos / blk->part.IL;
+    i = blk->sbloc + sub_blk_id * K * blk->part.IL +
+        (uint64_t)symbol_id * blk->part.IL + pos % blk->part.IL;
   } else {
-    size_t pos_part2 = pos - blk->part_tot;
-    size_t sub_blk_id = pos_part2 / blk->part.IS;
-    i = blk->sbloc + (blk->part_tot * K) + sub_blk_id * K * blk->part.IS +
-        symbol_id * blk->part.IS + pos_part2 % blk->part.IS;
+    uint64_t pos_part2 = pos - blk->part_tot;
+    uint64_t sub_blk_id = pos_part2 / blk->part.IS;
+    i = blk->sbloc + ((uint64_t)blk->part_tot * K) +
+        sub_blk_id * K * blk->part.IS + (uint64_t)symbol_id * blk->part.IS +
+        pos_part2 % blk->part.IS;
   }
 
   return i * blk->al;
 }
 
+/* positional io when it has it, seek and read or write otherwise. seek
+ * takes an int, so offsets past INT_MAX fail rather than wrap */
+static size_t nanorq_io_read(struct ioctx *io, void *buf, size_t len,
+                             uint64_t offset) {
+  if (io->read_at)
+    return io->read_at(io, buf, len, offset);
+  if (offset > INT_MAX || !io->seek(io, offset))
+    return 0;
+  return io->read(io, buf, len);
+}
+
+static size_t nanorq_io_write(struct ioctx *io, const void *buf, size_t len,
+                              uint64_t offset) {
+  if (io->write_at)
+    return io->write_at(io, buf, len, offset);
+  if (offset > INT_MAX || !io->seek(io, offset))
+    return 0;
+  return io->write(io, buf, len);
+}
+
+/* bytes of len from offset on that are part of the transfer, io has to
+ * give those, the rest is padding */
+static size_t nanorq_source_bytes(nanorq *rq, uint64_t offset, size_t len) {
+  if (offset >= rq->common.F)
+    return 0;
+  return (rq->common.F - offset < len) ? rq->common.F - offset : len;
+}
+
+static bool nanorq_io_flush(struct ioctx *io) {
+  return io->flush == NULL || io->flush(io);
+}
+
 static struct encoder_core *nanorq_block_encoder(nanorq *rq, uint8_t sbn) {
   uint16_t num_symbols = nanorq_block_symbols(rq, sbn);
   uint16_t symbol_size = rq->common.T / rq->common.Al;
@@ -150,72 +233,131 @@ static struct encoder_core *nanorq_block_encoder(nanorq *rq, uint8_t sbn) {
   enc->num_symbols = num_symbols;
   enc->symbol_size = symbol_size;
   enc->prm = params_init(num_symbols);
+  if (rq->tuple_cache > 0)
+    enc->cache = params_cache_new(rq->tuple_cache);
   rq->encoders[sbn] = enc;
   return enc;
 }
 
-bool nanorq_generate_symbols(nanorq *rq, uint8_t sbn, struct ioctx *io) {
-  octmat A = OM_INITIAL, D = OM_INITIAL;
-
-  struct encoder_core *enc = nanorq_block_encoder(rq, sbn);
-  struct pparams *prm = NULL;
-
-  if (enc == NULL)
-    return false;
-
-  if (enc->symbolmat.rows > 0)
-    return true;
-
-  prm = &enc->prm;
-  precode_matrix_gen(prm, &A, 0);
-
-  om_resize(&D, prm->K_padded + prm->S + prm->H,
-            enc->symbol_size * rq->common.Al);
+/* returns the length of sub-block sub in Al units, start gets its column */
+static uint16_t get_sub_block(struct source_block *blk, uint16_t sub,
+                              uint16_t *start) {
+  if (sub < blk->part.JL) {
+    *start = sub * blk->part.IL;
+    return blk->part.IL;
+  }
+  *start = blk->part_tot + (sub - blk->part.JL) * blk->part.IS;
+  return blk->part.IS;
+}
 
-  int row = 0, col = 0;
-  for (row = 0; row < prm->S + prm->H; row++) {
-    for (col = 0; col < D.cols; col++) {
-      om_A(D, row, col) = 0;
+/* reads one sub-block of the source symbols of a block into the D of its
+ * precode */
+static octmat nanorq_load_block(nanorq *rq, struct encoder_core *enc,
+                                struct ioctx *io, uint16_t sub) {
+  octmat D = OM_INITIAL;
+  struct pparams *prm = &enc->prm;
+  struct source_block blk = get_source_block(rq, enc->sbn, enc->symbol_size);
+  uint16_t start, len = get_sub_block(&blk, sub, &start);
+  uint16_t stride = len * rq->common.Al;
+  int skip = prm->S + prm->H;
+
+  om_resize(&D, prm->K_padded + skip, stride);
+  for (int row = 0; row < D.rows; row++) {
+    size_t got = 0;
+    uint32_t symbol_id = row - skip;
+    if (row >= skip && symbol_id < enc->num_symbols) {
+      uint64_t offset = get_symbol_offset(&blk, start, enc->num_symbols,
+                                          symbol_id);
+      got = nanorq_io_read(io, om_R(D, row), stride, offset);
+      if (got < nanorq_source_bytes(rq, offset, stride)) {
+        om_destroy(&D);
+        return D;
+      }
     }
+    memset(om_R(D, row) + got, 0, stride - got);
   }
+  return D;
+}
 
-  struct source_block blk = get_source_block(rq, sbn, enc->symbol_size);
-  for (; row < prm->S + prm->H + enc->num_symbols; row++) {
-    uint32_t symbol_id = row - (prm->S + prm->H);
-    col = 0;
-    for (int i = 0; i < enc->symbol_size;) {
-      size_t offset = get_symbol_offset(&blk, i, enc->num_symbols, symbol_id);
-      uint16_t sublen = (i < blk.part_tot) ? blk.part.IL : blk.part.IS;
-      uint16_t stride = sublen * rq->common.Al;
-      uint8_t buf[stride];
-      i += sublen;
+/* passes the bytes of the input block sbn is read from to one of io's
+ * hints */
+static void nanorq_block_hint(nanorq *rq, uint8_t sbn, struct ioctx *io,
+                              void (*hint)(struct ioctx *, uint64_t, size_t),
+                              pthread_mutex_t *lock) {
+  uint16_t symbol_size = rq->common.T / rq->common.Al;
+  struct source_block blk = get_source_block(rq, sbn, symbol_size);
+
+  if (hint == NULL)
+    return;
+  if (lock)
+    pthread_mutex_lock(lock);
+  hint(io, blk.sbloc * rq->common.Al,
+       (size_t)nanorq_block_symbols(rq, sbn) * rq->common.T);
+  if (lock)
+    pthread_mutex_unlock(lock);
+}
 
-      size_t got = 0;
-      if (io->seek(io, offset)) {
-        got = io->read(io, buf, stride);
-      }
-      for (int byte = 0; byte < got; byte++) {
-        om_A(D, row, col++) = buf[byte];
-      }
-      for (int byte = got; byte < stride; byte++) {
-        om_A(D, row, col++) = 0;
-      }
+/*
+ * solves the precode of a block one sub-block at a time so only a sub-block
+ * wide D is live, the plan is shared by all of them. reads from io are done
+ * under lock when one is given. io is told to read the block and the one
+ * after it ahead, so the next block's reads overlap solving this one. the
+ * block's input is still needed for its source symbols, so it is released
+ * only by nanorq_encode_pipeline once they are sent.
+ */
+static bool nanorq_solve_symbols(nanorq *rq, struct encoder_core *enc,
+                                 struct ioctx *io, pthread_mutex_t *lock) {
+  uint16_t num_subs = rq->sub_part.JL + rq->sub_part.JS;
+  struct source_block blk = get_source_block(rq, enc->sbn, enc->symbol_size);
+  bool ok = true;
+
+  nanorq_block_hint(rq, enc->sbn, io, io->prefetch, lock);
+  if (enc->sbn + 1 < nanorq_blocks(rq))
+    nanorq_block_hint(rq, enc->sbn + 1, io, io->prefetch, lock);
+  for (uint16_t sub = 0; sub < num_subs; sub++) {
+    uint16_t start;
+    get_sub_block(&blk, sub, &start);
+
+    if (lock)
+      pthread_mutex_lock(lock);
+    octmat D = nanorq_load_block(rq, enc, io, sub);
+    if (lock)
+      pthread_mutex_unlock(lock);
+
+    octmat C = OM_INITIAL;
+    if (D.rows > 0)
+      C = precode_matrix_solve(&enc->prm, &D, rq->pool);
+    om_destroy(&D);
+    if (C.rows == 0) {
+      om_destroy(&enc->symbolmat);
+      ok = false;
+      break;
     }
+    if (num_subs == 1) {
+      enc->symbolmat = C;
+      break;
+    }
+    if (enc->symbolmat.rows == 0)
+      om_resize(&enc->symbolmat, C.rows, enc->symbol_size * rq->common.Al);
+    for (int row = 0; row < C.rows; row++) {
+      memcpy(om_R(enc->symbolmat, row) + start * rq->common.Al, om_R(C, row),
+             C.cols);
+    }
+    om_destroy(&C);
   }
+  return ok;
+}
 
-  for (; row < D.rows; row++) {
-    for (int col = 0; col < D.cols; col++)
-      om_A(D, row, col) = 0;
-  }
+bool nanorq_generate_symbols(nanorq *rq, uint8_t sbn, struct ioctx *io) {
+  struct encoder_core *enc = nanorq_block_encoder(rq, sbn);
 
-  enc->symbolmat = precode_matrix_intermediate1(prm, &A, &D);
-  if (enc->symbolmat.rows == 0)
+  if (enc == NULL)
     return false;
 
-  om_destroy(&A);
-  om_destroy(&D);
+  if (enc->symbolmat.rows > 0)
+    return true;
 
-  return true;
+  return nanorq_solve_symbols(rq, enc, io, NULL);
 }
 
 /*
@@ -223,10 +365,13 @@ bool nanorq_generate_symbols(nanorq *rq, uint8_t sbn, struct ioctx *io) {
  * T: size of each symbol in bytes (should be aligned to Al)
  * K: number of symbols per block (set Z to zero);
  * Z: number of source blocks     (set K to zero);
+ * SS, WS: sub-symbol size in Al units and working memory in bytes, picks
+ *         Z and N instead of K and Z when WS is set
  * Al: symbol alignment size
  */
-nanorq *nanorq_encoder_new_ex(uint64_t len, uint16_t T, uint16_t K, uint16_t Z,
-                              uint8_t Al) {
+static nanorq *nanorq_encoder_setup(uint64_t len, uint16_t T, uint16_t K,
+                                    uint16_t Z, uint16_t SS, uint32_t WS,
+                                    uint8_t Al) {
   nanorq *rq = NULL;
 
   uint8_t alignments[] = {1, 2, 4, 8};
@@ -263,10 +408,14 @@ nanorq *nanorq_encoder_new_ex(uint64_t len, uint16_t T, uint16_t K, uint16_t Z,
   rq->common.T = T;
   rq->common.Al = Al;
 
-  rq->scheme = gen_scheme_specific(&rq->common, K, Z);
+  if (WS > 0) {
+    rq->scheme = gen_scheme_ws(&rq->common, SS, WS);
+  } else {
+    rq->scheme = gen_scheme_specific(&rq->common, K, Z);
+  }
 
   if (rq->scheme.Z == 0 || rq->scheme.N == 0 || rq->scheme.Z >= Z_max ||
-      div_ceil(rq->scheme.Kt, rq->scheme.Z) > K_max) {
+      rq->scheme.N > T / Al || div_ceil(rq->scheme.Kt, rq->scheme.Z) > K_max) {
     free(rq);
     return NULL;
   }
@@ -287,7 +436,58 @@ nanorq *nanorq_encoder_new_ex(uint64_t len, uint16_t T, uint16_t K, uint16_t Z,
 }
 
 nanorq *nanorq_encoder_new(uint64_t len, uint16_t T, uint8_t Al) {
-  return nanorq_encoder_new_ex(len, T, 0, 0, Al);
+  return nanorq_encoder_setup(len, T, 0, 0, 0, 0, Al);
+}
+
+nanorq *nanorq_encoder_new_ex(uint64_t len, uint16_t T, uint16_t K, uint16_t Z,
+                              uint8_t Al) {
+  return nanorq_encoder_setup(len, T, K, Z, 0, 0, Al);
+}
+
+nanorq *nanorq_encoder_new_ws(uint64_t len, uint16_t T, uint16_t SS,
+                              uint32_t WS, uint8_t Al) {
+  if (SS == 0 || WS == 0)
+    return NULL;
+  return nanorq_encoder_setup(len, T, 0, 0, SS, WS, Al);
+}
+
+void nanorq_set_block_threads(nanorq *rq, int threads) {
+  pool_free(rq->pool);
+  rq->pool = (threads > 1) ? pool_new(threads) : NULL;
+}
+
+void nanorq_set_tuple_cache(nanorq *rq, uint32_t slots) {
+  rq->tuple_cache = slots;
+}
+
+void nanorq_plan_cache_clear(void) { plan_cache_clear(); }
+
+bool nanorq_plan_catalog_write(const char *path, const uint16_t *num_symbols,
+                               size_t count) {
+  struct plan **plans;
+  bool ok = true;
+
+  if (count == 0)
+    return false;
+  plans = calloc(count, sizeof(struct plan *));
+  if (plans == NULL)
+    return false;
+  for (size_t idx = 0; ok && idx < count; idx++) {
+    if (num_symbols[idx] == 0 || num_symbols[idx] > K_max)
+      ok = false;
+    if (ok) {
+      struct pparams prm = params_init(num_symbols[idx]);
+      plans[idx] = precode_matrix_plan(&prm);
+      ok = (plans[idx] != NULL);
+    }
+  }
+  ok = ok && plan_catalog_write(path, plans, count);
+  free(plans);
+  return ok;
+}
+
+bool nanorq_plan_catalog_load(const char *path) {
+  return plan_catalog_load(path);
 }
 
 void nanorq_free(nanorq *rq) {
@@ -297,6 +497,7 @@ void nanorq_free(nanorq *rq) {
       nanorq_encode_cleanup(rq, sbn);
       nanorq_decode_cleanup(rq, sbn);
     }
+    pool_free(rq->pool);
     free(rq);
   }
 }
@@ -329,6 +530,11 @@ uint64_t nanorq_transfer_length(nanorq *rq) { return rq->common.F; }
 uint16_t nanorq_symbol_size(nanorq *rq) { return rq->common.T; }
 
 nanorq *nanorq_decoder_new(uint64_t common, uint32_t scheme) {
+  return nanorq_decoder_new_ex(common, scheme, false);
+}
+
+nanorq *nanorq_decoder_new_ex(uint64_t common, uint32_t scheme,
+                              bool incremental) {
   uint64_t F = common >> 24;
   uint16_t T = common & 0xffff;
 
@@ -341,6 +547,7 @@ nanorq *nanorq_decoder_new(uint64_t common, uint32_t scheme) {
 
   rq->common.F = F;
   rq->common.T = T;
+  rq->incremental = incremental;
 
   rq->scheme.Z = (scheme >> 24) & 0xff;
   rq->scheme.N = (scheme >> 8) & 0xffff;
@@ -410,26 +617,17 @@ uint64_t nanorq_encode(nanorq *rq, void *data, uint32_t esi, uint8_t sbn,
     struct source_block blk = get_source_block(rq, sbn, enc->symbol_size);
     uint8_t *dst = ((uint8_t *)data);
     for (int i = 0; i < enc->symbol_size;) {
-      size_t offset = get_symbol_offset(&blk, i, enc->num_symbols, esi);
+      uint64_t offset = get_symbol_offset(&blk, i, enc->num_symbols, esi);
       uint16_t sublen = (i < blk.part_tot) ? blk.part.IL : blk.part.IS;
       uint16_t stride = sublen * rq->common.Al;
-      uint8_t buf[stride];
       i += sublen;
 
-      int got = 0;
-      if (io->seek(io, offset)) {
-        got = io->read(io, buf, stride);
-      }
-      for (int byte = 0; byte < got; byte++) {
-        *dst = buf[byte];
-        dst++;
-        written++;
-      }
-      for (int byte = got; byte < stride; byte++) {
-        *dst = 0;
-        dst++;
-        written++;
-      }
+      size_t got = nanorq_io_read(io, dst, stride, offset);
+      if (got < nanorq_source_bytes(rq, offset, stride))
+        return 0;
+      memset(dst + got, 0, stride - got);
+      dst += stride;
+      written += stride;
     }
   } else {
     // esi is for repair symbol
@@ -441,25 +639,74 @@ uint64_t nanorq_encode(nanorq *rq, void *data, uint32_t esi, uint8_t sbn,
     }
 
     uint32_t isi = esi + (prm->K_padded - enc->num_symbols);
-    octmat tmp = precode_matrix_encode(prm, &enc->symbolmat, isi);
-    uint8_t *dst = ((uint8_t *)data);
-    uint8_t *octet = om_P(tmp);
-    for (int i = 0; i < enc->symbol_size; i++) {
-      for (int byte = 0; byte < rq->common.Al; byte++) {
-        *dst = (octet == NULL) ? 0 : *(octet++);
-        dst++;
-        written++;
-      }
-    }
-    om_destroy(&tmp);
+    /* summed straight into the caller's buffer */
+    precode_matrix_encode(prm, enc->cache, &enc->symbolmat, isi, data);
+    written = enc->symbolmat.cols;
   }
   return written;
 }
 
+int nanorq_source_iov(nanorq *rq, uint8_t sbn, uint32_t esi,
+                      struct ioctx *io, struct iovec *iov, int iovcnt,
+                      void *pad) {
+  struct encoder_core *enc = nanorq_block_encoder(rq, sbn);
+  int cnt = 0;
+
+  if (enc == NULL || esi >= enc->num_symbols || iovcnt < 1)
+    return 0;
+
+  /* a piece io can't map, including the short end of the input, sends the
+   * whole symbol through pad */
+  struct source_block blk = get_source_block(rq, sbn, enc->symbol_size);
+  for (int i = 0; i < enc->symbol_size && io->map;) {
+    uint64_t offset = get_symbol_offset(&blk, i, enc->num_symbols, esi);
+    uint16_t sublen = (i < blk.part_tot) ? blk.part.IL : blk.part.IS;
+    uint16_t stride = sublen * rq->common.Al;
+    i += sublen;
+
+    const void *ptr = (cnt < iovcnt) ? io->map(io, offset, stride) : NULL;
+    if (ptr == NULL || offset + stride > rq->common.F) {
+      cnt = 0;
+      break;
+    }
+    iov[cnt].iov_base = (void *)ptr;
+    iov[cnt].iov_len = stride;
+    cnt++;
+  }
+  if (cnt == 0) {
+    if (nanorq_encode(rq, pad, esi, sbn, io) == 0)
+      return 0;
+    iov[0].iov_base = pad;
+    iov[0].iov_len = rq->common.T;
+    cnt = 1;
+  }
+  return cnt;
+}
+
+uint32_t nanorq_encode_batch(nanorq *rq, uint8_t sbn, uint32_t first_esi,
+                             uint32_t count, void *out, size_t stride,
+                             struct ioctx *io) {
+  struct encoder_core *enc = nanorq_block_encoder(rq, sbn);
+
+  if (enc == NULL || stride < rq->common.T)
+    return 0;
+  if (first_esi >= (1 << 20))
+    return 0;
+  if (count > (1 << 20) - first_esi)
+    count = (1 << 20) - first_esi;
+  if (enc->symbolmat.rows == 0 && !nanorq_generate_symbols(rq, sbn, io))
+    return 0;
+
+  precode_matrix_encode_batch(&enc->prm, enc->cache, &enc->symbolmat,
+                              enc->num_symbols, first_esi, count, out, stride);
+  return count;
+}
+
 void nanorq_encode_cleanup(nanorq *rq, uint8_t sbn) {
   if (rq->encoders[sbn]) {
     struct encoder_core *enc = rq->encoders[sbn];
     om_destroy(&enc->symbolmat);
+    params_cache_free(enc->cache);
     free(enc);
     rq->encoders[sbn] = NULL;
   }
@@ -482,6 +729,8 @@ static struct decoder_core *nanorq_block_decoder(nanorq *rq, uint8_t sbn) {
   dec->prm = params_init(num_symbols);
   dec->mask = bitmask_new(num_symbols);
   om_resize(&dec->symbolmat, num_symbols, symbol_size * rq->common.Al);
+  if (rq->incremental)
+    dec->inc = incdec_new(&dec->prm, num_symbols, dec->symbolmat.cols);
 
   rq->decoders[sbn] = dec;
   return dec;
@@ -519,6 +768,13 @@ bool nanorq_decoder_add_symbol(nanorq *rq, void *data, uint32_t fid) {
   }
   bitmask_set(dec->mask, esi);
 
+  if (dec->inc) {
+    uint32_t isi = esi;
+    if (esi >= dec->num_symbols)
+      isi += dec->prm.K_padded - dec->num_symbols;
+    incdec_add(dec->inc, isi, data);
+  }
+
   return true;
 }
 
@@ -539,19 +795,48 @@ uint32_t nanorq_num_repair(nanorq *rq, uint8_t sbn) {
   return kv_size(dec->repair_bin);
 }
 
-uint64_t nanorq_decode_block(nanorq *rq, struct ioctx *io, uint8_t sbn) {
-  uint64_t written = 0;
-
+bool nanorq_decoder_ready(nanorq *rq, uint8_t sbn) {
   struct decoder_core *dec = nanorq_block_decoder(rq, sbn);
-  struct pparams *prm = &dec->prm;
   if (dec == NULL)
-    return 0;
+    return false;
 
-  bool success =
-      precode_matrix_decode(prm, &dec->symbolmat, &dec->repair_bin, dec->mask);
-  if (!success) {
-    return 0;
+  if (bitmask_gaps(dec->mask, dec->num_symbols) == 0)
+    return true;
+  return dec->inc && incdec_complete(dec->inc);
+}
+
+static bool nanorq_solve_block(nanorq *rq, struct decoder_core *dec) {
+  struct pparams *prm = &dec->prm;
+  uint16_t num_subs = rq->sub_part.JL + rq->sub_part.JS;
+
+  if (dec->inc && incdec_complete(dec->inc)) {
+    precode_matrix_fill_gaps(prm, &dec->inc->D, &dec->symbolmat, dec->mask, 0);
+    return true;
+  }
+  if (num_subs == 1) {
+    return precode_matrix_decode(prm, &dec->symbolmat, &dec->repair_bin,
+                                 dec->mask, rq->pool, NULL);
+  }
+
+  /* the received symbols are solved once and replayed per sub-block */
+  struct source_block blk = get_source_block(rq, dec->sbn, dec->symbol_size);
+  uint16_vec subs;
+  kv_init(subs);
+  for (uint16_t sub = 0; sub < num_subs; sub++) {
+    uint16_t start, len = get_sub_block(&blk, sub, &start);
+    kv_push(uint16_t, subs, len * rq->common.Al);
   }
+  bool success = precode_matrix_decode(prm, &dec->symbolmat, &dec->repair_bin,
+                                       dec->mask, rq->pool, &subs);
+  kv_destroy(subs);
+  return success;
+}
+
+/* writes the source symbols of a decoded block to io */
+static uint64_t nanorq_write_block(nanorq *rq, struct decoder_core *dec,
+                                   struct ioctx *io) {
+  uint64_t written = 0;
+  uint8_t sbn = dec->sbn;
 
   int max_esi = dec->symbolmat.rows;
   int row = 0, col = 0;
@@ -559,27 +844,232 @@ uint64_t nanorq_decode_block(nanorq *rq, struct ioctx *io, uint8_t sbn) {
   for (; row < max_esi; row++) {
     col = 0;
     for (int i = 0; i < dec->symbol_size;) {
-      size_t offset = get_symbol_offset(&blk, i, max_esi, row);
+      uint64_t offset = get_symbol_offset(&blk, i, max_esi, row);
       uint16_t sublen = (i < blk.part_tot) ? blk.part.IL : blk.part.IS;
       uint16_t stride = sublen * rq->common.Al;
       i += sublen;
 
-      if (io->seek(io, offset)) {
+      if (offset < rq->common.F) {
         uint16_t len = stride;
-        if (offset >= rq->common.F)
-          continue;
         if ((offset + stride) >= rq->common.F) {
           len = (rq->common.F - offset);
         }
-        written += io->write(io, om_R(dec->symbolmat, row) + col, len);
-        col += stride;
+        written += nanorq_io_write(io, om_R(dec->symbolmat, row) + col, len,
+                                   offset);
       }
+      col += stride;
     }
   }
 
   return written;
 }
 
+uint64_t nanorq_decode_block(nanorq *rq, struct ioctx *io, uint8_t sbn) {
+  struct decoder_core *dec = nanorq_block_decoder(rq, sbn);
+  if (dec == NULL)
+    return 0;
+
+  if (!nanorq_solve_block(rq, dec))
+    return 0;
+  uint64_t written = nanorq_write_block(rq, dec, io);
+  return nanorq_io_flush(io) ? written : 0;
+}
+
+/*
+ * blocks are independent, so the _all entry points hand them out to a pool
+ * of workers. io is shared, reads and writes to it are done under the lock
+ * while the solving runs in parallel, unless io is positional and so safe
+ * to use from every worker at once.
+ */
+struct nanorq_all {
+  nanorq *rq;
+  struct ioctx *io;
+  pthread_mutex_t lock; /* guards io and the totals */
+  bool ok;
+  uint64_t written;
+};
+
+static void nanorq_all_generate(void *arg, int sbn) {
+  struct nanorq_all *all = arg;
+  struct encoder_core *enc = nanorq_block_encoder(all->rq, sbn);
+  bool ok = (enc != NULL);
+
+  if (ok && enc->symbolmat.rows == 0) {
+    pthread_mutex_t *lock = all->io->read_at ? NULL : &all->lock;
+    ok = nanorq_solve_symbols(all->rq, enc, all->io, lock);
+  }
+  if (!ok) {
+    pthread_mutex_lock(&all->lock);
+    all->ok = false;
+    pthread_mutex_unlock(&all->lock);
+  }
+}
+
+static void nanorq_all_decode(void *arg, int sbn) {
+  struct nanorq_all *all = arg;
+  struct decoder_core *dec = nanorq_block_decoder(all->rq, sbn);
+  bool ok = (dec != NULL) && nanorq_solve_block(all->rq, dec);
+  uint64_t written = 0;
+
+  if (ok && all->io->write_at)
+    written = nanorq_write_block(all->rq, dec, all->io);
+
+  pthread_mutex_lock(&all->lock);
+  if (ok && !all->io->write_at)
+    written = nanorq_write_block(all->rq, dec, all->io);
+  if (ok) {
+    all->written += written;
+  } else {
+    all->ok = false;
+  }
+  pthread_mutex_unlock(&all->lock);
+}
+
+static void nanorq_all_run(struct nanorq_all *all, void (*fn)(void *, int),
+                           int threads) {
+  int num_sbn = nanorq_blocks(all->rq);
+  struct pool *pool = NULL;
+
+  if (threads > num_sbn)
+    threads = num_sbn;
+  if (threads > 1)
+    pool = pool_new(threads);
+  pthread_mutex_init(&all->lock, NULL);
+  pool_run(pool, fn, all, num_sbn);
+  pthread_mutex_destroy(&all->lock);
+  pool_free(pool);
+}
+
+bool nanorq_generate_all(nanorq *rq, struct ioctx *io, int threads) {
+  struct nanorq_all all = {.rq = rq, .io = io, .ok = true};
+
+  nanorq_all_run(&all, nanorq_all_generate, threads);
+  return all.ok;
+}
+
+uint64_t nanorq_decode_all(nanorq *rq, struct ioctx *io, int threads) {
+  struct nanorq_all all = {.rq = rq, .io = io, .ok = true};
+
+  nanorq_all_run(&all, nanorq_all_decode, threads);
+  return (all.ok && nanorq_io_flush(io)) ? all.written : 0;
+}
+
+/*
+ * the pipeline solves blocks in order on a worker while the caller emits
+ * the solved ones, so reading block n+1 (prefetched by the solve of n),
+ * solving n and emitting n-1 overlap. the solver stays fewer than depth
+ * blocks ahead of the emitted ones, each block is cleaned up and its
+ * input released once emitted.
+ */
+struct nanorq_pipeline {
+  nanorq *rq;
+  struct ioctx *io;
+  pthread_mutex_t lock; /* guards the counts and ok */
+  pthread_cond_t cond;  /* signalled when either count moves */
+  int depth;
+  int solved;  /* blocks solved, in sbn order */
+  int emitted; /* blocks emitted and cleaned up */
+  bool ok;     /* cleared when a solve fails or emit stops */
+};
+
+static void *nanorq_pipeline_solver(void *arg) {
+  struct nanorq_pipeline *pipe = arg;
+  int num_sbn = nanorq_blocks(pipe->rq);
+
+  for (int sbn = 0; sbn < num_sbn; sbn++) {
+    pthread_mutex_lock(&pipe->lock);
+    while (pipe->ok && sbn >= pipe->emitted + pipe->depth)
+      pthread_cond_wait(&pipe->cond, &pipe->lock);
+    bool ok = pipe->ok;
+    pthread_mutex_unlock(&pipe->lock);
+    if (!ok)
+      break;
+
+    struct encoder_core *enc = nanorq_block_encoder(pipe->rq, sbn);
+    ok = (enc != NULL) && nanorq_solve_symbols(pipe->rq, enc, pipe->io, NULL);
+
+    pthread_mutex_lock(&pipe->lock);
+    if (ok) {
+      pipe->solved++;
+    } else {
+      pipe->ok = false;
+    }
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+    if (!ok)
+      break;
+  }
+  return NULL;
+}
+
+/* emits a solved block and lets its resources go */
+static bool nanorq_pipeline_emit(struct nanorq_pipeline *pipe, uint8_t sbn,
+                                 nanorq_emit_fn emit, void *arg) {
+  bool ok = emit(pipe->rq, sbn, arg);
+
+  nanorq_block_hint(pipe->rq, sbn, pipe->io, pipe->io->release, NULL);
+  nanorq_encode_cleanup(pipe->rq, sbn);
+  return ok;
+}
+
+bool nanorq_encode_pipeline(nanorq *rq, struct ioctx *io, int depth,
+                            nanorq_emit_fn emit, void *arg) {
+  struct nanorq_pipeline pipe = {
+      .rq = rq, .io = io, .depth = (depth > 1) ? depth : 1, .ok = true};
+  int num_sbn = nanorq_blocks(rq);
+  pthread_t tid;
+
+  /* emit reads source symbols from io while the worker solves */
+  bool threaded = (io->read_at != NULL && depth > 1);
+
+  pthread_mutex_init(&pipe.lock, NULL);
+  pthread_cond_init(&pipe.cond, NULL);
+  if (threaded)
+    threaded = pthread_create(&tid, NULL, nanorq_pipeline_solver, &pipe) == 0;
+  if (!threaded) {
+    pthread_cond_destroy(&pipe.cond);
+    pthread_mutex_destroy(&pipe.lock);
+    for (int sbn = 0; sbn < num_sbn; sbn++) {
+      struct encoder_core *enc = nanorq_block_encoder(rq, sbn);
+      if (enc == NULL || !nanorq_solve_symbols(rq, enc, io, NULL) ||
+          !nanorq_pipeline_emit(&pipe, sbn, emit, arg)) {
+        nanorq_encode_cleanup(rq, sbn);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  for (int sbn = 0; sbn < num_sbn; sbn++) {
+    pthread_mutex_lock(&pipe.lock);
+    while (pipe.ok && pipe.solved <= sbn)
+      pthread_cond_wait(&pipe.cond, &pipe.lock);
+    bool ok = (pipe.solved > sbn);
+    pthread_mutex_unlock(&pipe.lock);
+    if (!ok)
+      break;
+
+    ok = nanorq_pipeline_emit(&pipe, sbn, emit, arg);
+
+    pthread_mutex_lock(&pipe.lock);
+    pipe.emitted++;
+    if (!ok)
+      pipe.ok = false;
+    pthread_cond_broadcast(&pipe.cond);
+    pthread_mutex_unlock(&pipe.lock);
+    if (!ok)
+      break;
+  }
+  pthread_join(tid, NULL);
+  pthread_cond_destroy(&pipe.cond);
+  pthread_mutex_destroy(&pipe.lock);
+
+  /* blocks solved ahead of a stop */
+  for (int sbn = pipe.emitted; sbn < num_sbn; sbn++)
+    nanorq_encode_cleanup(rq, sbn);
+  return pipe.ok && pipe.emitted == num_sbn;
+}
+
 void nanorq_decode_cleanup(nanorq *rq, uint8_t sbn) {
   if (rq->decoders[sbn]) {
     struct decoder_core *dec = rq->decoders[sbn];
@@ -591,6 +1081,7 @@ void nanorq_decode_cleanup(nanorq *rq, uint8_t sbn) {
       kv_destroy(dec->repair_bin);
     }
     bitmask_free(dec->mask);
+    incdec_free(dec->inc);
     free(dec);
     rq->decoders[sbn] = NULL;
   }
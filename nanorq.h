@@ -5,6 +5,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <sys/uio.h>
+
 #include "io.h"
 
 static const uint64_t NANORQ_MAX_TRANSFER = 946270874880ULL; // ~881 GB
@@ -16,12 +18,58 @@ nanorq *nanorq_encoder_new(uint64_t len, uint16_t T, uint8_t Al);
 nanorq *nanorq_encoder_new_ex(uint64_t len, uint16_t T, uint16_t K, uint16_t Z,
                               uint8_t Al);
 
+// returns a new encoder that splits each block into sub-blocks of at least
+// SS * Al bytes so that one sub-block's solve fits in WS bytes of memory
+nanorq *nanorq_encoder_new_ws(uint64_t len, uint16_t T, uint16_t SS,
+                              uint32_t WS, uint8_t Al);
+
 // returns success of generating symbols for a given sbn
 bool nanorq_generate_symbols(nanorq *rq, uint8_t sbn, struct ioctx *io);
 
+// generates symbols for every sbn on up to threads threads, returns success
+// of all of them
+bool nanorq_generate_all(nanorq *rq, struct ioctx *io, int threads);
+
+// called once per block in sbn order on the thread that runs
+// nanorq_encode_pipeline, encodes and sends the symbols of the solved block
+// sbn. returns false to stop the pipeline
+typedef bool (*nanorq_emit_fn)(nanorq *rq, uint8_t sbn, void *arg);
+
+// solves blocks on a worker thread while emit sends the solved ones, so
+// the first symbols go out after one block is solved. the worker stays
+// fewer than depth blocks ahead of emit, which bounds the blocks in memory;
+// a block is cleaned up once emitted. io needs read_at and depth 2 or more
+// for the stages to overlap, otherwise they run in turn. returns true once
+// every block was emitted
+bool nanorq_encode_pipeline(nanorq *rq, struct ioctx *io, int depth,
+                            nanorq_emit_fn emit, void *arg);
+
+// lets the solve of a single block split its symbol columns over up to
+// threads threads, for transfers with few but large blocks. the threads are
+// started here and kept until nanorq_free, blocks too small to gain from
+// them are solved on the calling thread alone
+void nanorq_set_block_threads(nanorq *rq, int threads);
+
+// keeps the tuples of up to slots repair ESIs per block so senders that
+// repeat ESIs skip regenerating them, encodes of one block must then not
+// run concurrently. set before the first encode
+void nanorq_set_tuple_cache(nanorq *rq, uint32_t slots);
+
 // frees up any resources used by a decoder/encoder
 void nanorq_free(nanorq *rq);
 
+// frees the solve plans encoders cache for each block size (K') and unmaps
+// loaded catalogs. plans are used without a reference, so this must not run
+// while any encoder may be generating symbols
+void nanorq_plan_cache_clear(void);
+
+// solves the given block sizes and writes their plans to a catalog file
+bool nanorq_plan_catalog_write(const char *path, const uint16_t *num_symbols,
+                               size_t count);
+
+// maps a plan catalog into the cache so encoders skip the first solve
+bool nanorq_plan_catalog_load(const char *path);
+
 // returns basic parameters to initialize a decoder
 uint64_t nanorq_oti_common(nanorq *rq);
 
@@ -46,16 +94,38 @@ uint32_t nanorq_fid(uint8_t sbn, uint32_t esi);
 // return the max number of repair symbols allowed
 uint32_t nanorq_encoder_max_repair(nanorq *rq, uint8_t sbn);
 
-// return the number of bytes written for a given sbn and esi encode request
+// return the number of bytes written for a given sbn and esi encode request,
+// data needs room for T bytes at any alignment, repair symbols are summed
+// into it in place so it can point right past a packet header
 uint64_t nanorq_encode(nanorq *rq, void *data, uint32_t esi, uint8_t sbn,
                        struct ioctx *io);
 
+// points iov at source symbol esi in place, one entry per sub-block, when
+// io can map it. otherwise, as for the short final symbol, the symbol is
+// copied and padded into pad (T bytes) and given as one entry. returns the
+// number of entries used, 0 if esi isn't a source symbol
+int nanorq_source_iov(nanorq *rq, uint8_t sbn, uint32_t esi,
+                      struct ioctx *io, struct iovec *iov, int iovcnt,
+                      void *pad);
+
+// writes count symbols of sbn from first_esi on into out, each symbol
+// stride bytes after the previous one, returns the number written. like
+// nanorq_encode, the block is generated from io first if it wasn't yet
+uint32_t nanorq_encode_batch(nanorq *rq, uint8_t sbn, uint32_t first_esi,
+                             uint32_t count, void *out, size_t stride,
+                             struct ioctx *io);
+
 // cleanup encoder resouces of a given block
 void nanorq_encode_cleanup(nanorq *rq, uint8_t sbn);
 
 // returns a new decoder initialized with given parameters
 nanorq *nanorq_decoder_new(uint64_t common, uint32_t specific);
 
+// returns a new decoder, incremental decoders reduce each symbol as it is
+// added so little work is left once the last needed symbol arrives
+nanorq *nanorq_decoder_new_ex(uint64_t common, uint32_t specific,
+                              bool incremental);
+
 // returns the success of adding a symbol to the decoder
 bool nanorq_decoder_add_symbol(nanorq *rq, void *data, uint32_t fid);
 
@@ -65,9 +135,19 @@ uint32_t nanorq_num_missing(nanorq *rq, uint8_t sbn);
 // returns number of repair symbols in decoder for given block
 uint32_t nanorq_num_repair(nanorq *rq, uint8_t sbn);
 
-// returns the number of bytes written from decoding a given sbn
+// returns true once sbn needs no solve, because no source symbol is missing
+// or an incremental decoder has reduced enough symbols. decoding it then
+// only writes the symbols out
+bool nanorq_decoder_ready(nanorq *rq, uint8_t sbn);
+
+// returns the number of bytes written from decoding a given sbn, once io
+// has them all, or 0 if the decode or a write failed
 uint64_t nanorq_decode_block(nanorq *rq, struct ioctx *io, uint8_t sbn);
 
+// decodes every sbn on up to threads threads, returns the number of bytes
+// written once io has them all, or 0 if any block or write failed
+uint64_t nanorq_decode_all(nanorq *rq, struct ioctx *io, int threads);
+
 // cleanup decoder resouces of a given block
 void nanorq_decode_cleanup(nanorq *rq, uint8_t sbn);
 
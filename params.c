@@ -1,3 +1,5 @@
+#include <stdlib.h>
+
 #include "params.h"
 #include "rand.h"
 
@@ -98,27 +100,54 @@ struct pparams params_init(uint16_t symbols) {
   return prm;
 }
 
-uint16_vec params_get_idxs(struct pparams *prm, uint32_t X) {
-  uint16_vec ret;
+struct params_idxs params_get_idxs(struct pparams *prm, uint32_t X) {
   struct ptuple t = gen_tuple(X, prm->J, prm->W, prm->P1);
+  struct params_idxs ret;
 
-  kv_init(ret);
-  kv_resize(uint16_t, ret, t.d + t.d1);
-  kv_push(uint16_t, ret, t.b);
+  ret.len = 0;
+  ret.idx[ret.len++] = t.b;
 
   for (int j = 1; j < t.d; j++) {
     t.b = (t.b + t.a) % prm->W;
-    kv_push(uint16_t, ret, t.b);
+    ret.idx[ret.len++] = t.b;
   }
   while (t.b1 >= prm->P)
     t.b1 = (t.b1 + t.a1) % prm->P1;
 
-  kv_push(uint16_t, ret, prm->W + t.b1);
+  ret.idx[ret.len++] = prm->W + t.b1;
   for (int j = 1; j < t.d1; j++) {
     t.b1 = (t.b1 + t.a1) % prm->P1;
     while (t.b1 >= prm->P)
       t.b1 = (t.b1 + t.a1) % prm->P1;
-    kv_push(uint16_t, ret, prm->W + t.b1);
+    ret.idx[ret.len++] = prm->W + t.b1;
   }
   return ret;
 }
+
+struct params_cache *params_cache_new(uint32_t slots) {
+  struct params_cache *cache = calloc(1, sizeof(struct params_cache));
+
+  cache->slots = slots;
+  cache->keys = calloc(slots, sizeof(uint32_t));
+  cache->idxs = calloc(slots, sizeof(struct params_idxs));
+  return cache;
+}
+
+const struct params_idxs *params_cache_get(struct params_cache *cache,
+                                           struct pparams *prm, uint32_t X) {
+  uint32_t slot = X % cache->slots;
+
+  if (cache->keys[slot] != X + 1) {
+    cache->idxs[slot] = params_get_idxs(prm, X);
+    cache->keys[slot] = X + 1;
+  }
+  return &cache->idxs[slot];
+}
+
+void params_cache_free(struct params_cache *cache) {
+  if (cache) {
+    free(cache->keys);
+    free(cache->idxs);
+    free(cache);
+  }
+}
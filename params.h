@@ -18,7 +18,28 @@ struct pparams {
   uint16_t J;
 };
 
+/* a tuple has at most 30 LT and 3 PI indices */
+#define PARAMS_MAX_IDXS 33
+
+/* the intermediate symbols an encoding symbol is the sum of */
+struct params_idxs {
+  uint16_t len;
+  uint16_t idx[PARAMS_MAX_IDXS];
+};
+
+/* direct mapped cache of the tuples of a block's recently seen ISIs */
+struct params_cache {
+  uint32_t slots;
+  uint32_t *keys; /* X + 1 of each slot, 0 when empty */
+  struct params_idxs *idxs;
+};
+
 struct pparams params_init(uint16_t symbols);
-uint16_vec params_get_idxs(struct pparams *prm, uint32_t X);
+struct params_idxs params_get_idxs(struct pparams *prm, uint32_t X);
+
+struct params_cache *params_cache_new(uint32_t slots);
+const struct params_idxs *params_cache_get(struct params_cache *cache,
+                                           struct pparams *prm, uint32_t X);
+void params_cache_free(struct params_cache *cache);
 
 #endif
@@ -0,0 +1,358 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <oblas.h>
+
+#include "gf256.h"
+#include "params.h"
+#include "plan.h"
+
+/*
+ * catalog file layout, native byte order:
+ *   header, one entry per plan, then for each plan its ops followed by c.
+ * plan data is 8 byte aligned so it can be used straight from the mapping.
+ */
+#define PLAN_CATALOG_MAGIC 0x4e525150 /* NRQP */
+#define PLAN_CATALOG_VERSION 1
+
+/* columns of D are independent, so a replay can be split into strips of
+ * columns, one per pool thread and PLAN_STRIP_MIN bytes wide at least.
+ * strips only share out the work: each still walks every op over all rows,
+ * so a single thread replays D whole. */
+#define PLAN_STRIP_MIN 512
+/* bytes of row ops a replay has to come to, a few ms of kernel time,
+ * before it is worth waking up the pool for */
+#define PLAN_PARALLEL_BYTES (32 << 20)
+
+struct plan_catalog_hdr {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+};
+
+struct plan_catalog_entry {
+  uint16_t K_padded;
+  uint16_t rows;
+  uint32_t num_ops;
+  uint64_t offset;
+};
+
+struct plan_mapping {
+  void *base;
+  size_t size;
+};
+
+static kvec_t(struct plan *) plan_cache = {0, 0, NULL};
+static kvec_t(struct plan_mapping) plan_mappings = {0, 0, NULL};
+/* guards the cache and the mappings, blocks may be solved concurrently */
+static pthread_mutex_t plan_lock = PTHREAD_MUTEX_INITIALIZER;
+/* signalled when a pending plan is published */
+static pthread_cond_t plan_ready = PTHREAD_COND_INITIALIZER;
+
+struct plan *plan_new(uint16_t K_padded, uint16_t rows) {
+  struct plan *p = calloc(1, sizeof(struct plan));
+
+  p->K_padded = K_padded;
+  p->rows = rows;
+  kv_init(p->ops);
+  kv_init(p->c);
+
+  return p;
+}
+
+void plan_add(struct plan *p, uint8_t type, uint16_t dst, uint16_t src,
+              uint8_t beta) {
+  if (p == NULL)
+    return;
+  struct plan_op op = {type, beta, dst, src};
+  kv_push(struct plan_op, p->ops, op);
+}
+
+static void plan_swap(uint8_t *a, uint8_t *b, size_t len) {
+  uint8_t tmp[256];
+
+  while (len > 0) {
+    size_t n = (len < sizeof(tmp)) ? len : sizeof(tmp);
+    memcpy(tmp, a, n);
+    memcpy(a, b, n);
+    memcpy(b, tmp, n);
+    a += n;
+    b += n;
+    len -= n;
+  }
+}
+
+/* replays the ops on len columns of D from col on, in place */
+static void plan_apply_ops(struct plan *p, octmat *D, size_t col,
+                           size_t len) {
+  for (size_t idx = 0; idx < kv_size(p->ops); idx++) {
+    struct plan_op *op = &kv_A(p->ops, idx);
+    uint8_t *dst = om_R(*D, op->dst) + col;
+    uint8_t *src = om_R(*D, op->src) + col;
+    switch (op->type) {
+    case PLAN_SWAP:
+      plan_swap(dst, src, len);
+      break;
+    case PLAN_SCAL:
+      gf256_scal(dst, len, op->beta);
+      break;
+    case PLAN_AXPY:
+      gf256_axpy(dst, src, len, op->beta);
+      break;
+    }
+  }
+}
+
+struct plan_strips {
+  struct plan *p;
+  octmat *D;
+  size_t width;
+};
+
+static void plan_strip(void *arg, int idx) {
+  struct plan_strips *st = arg;
+  size_t col = idx * st->width;
+  size_t cols = st->D->cols - col;
+
+  if (cols > st->width)
+    cols = st->width;
+  plan_apply_ops(st->p, st->D, col, cols);
+}
+
+/*
+ * large D is replayed one column strip at a time so the strip stays in L2
+ * for the whole plan, the kernels work on the strip of each row in place.
+ * columns never mix, so once the replay is worth it the strips are shared
+ * out over the pool, at least PLAN_STRIP_MIN wide each.
+ */
+void plan_apply(struct plan *p, octmat *D, struct pool *pool) {
+  size_t width = D->cols;
+  int threads = pool_threads(pool);
+
+  if (threads > 1 && kv_size(p->ops) * D->cols >= PLAN_PARALLEL_BYTES) {
+    width = div_ceil(D->cols, threads);
+    width = div_ceil(width, OCTMAT_ALIGN) * OCTMAT_ALIGN;
+    if (width < PLAN_STRIP_MIN)
+      width = PLAN_STRIP_MIN;
+  }
+  if (width >= D->cols) {
+    plan_apply_ops(p, D, 0, D->cols);
+    return;
+  }
+
+  struct plan_strips st = {.p = p, .D = D, .width = width};
+  pool_run(pool, plan_strip, &st, div_ceil(D->cols, width));
+}
+
+void plan_free(struct plan *p) {
+  if (p) {
+    if (!p->mapped) {
+      kv_destroy(p->ops);
+      kv_destroy(p->c);
+    }
+    free(p);
+  }
+}
+
+static struct plan *plan_cache_find(uint16_t K_padded) {
+  for (size_t idx = 0; idx < kv_size(plan_cache); idx++) {
+    if (kv_A(plan_cache, idx)->K_padded == K_padded)
+      return kv_A(plan_cache, idx);
+  }
+  return NULL;
+}
+
+static void plan_cache_insert(struct plan *p) {
+  if (plan_cache_find(p->K_padded) != NULL) {
+    plan_free(p);
+    return;
+  }
+  kv_push(struct plan *, plan_cache, p);
+}
+
+/*
+ * returns the cached plan for K_padded, waiting for it while another thread
+ * solves it. when there is none the caller gets a new pending plan to fill
+ * and hand to plan_cache_publish, so each K' is only ever solved once.
+ */
+struct plan *plan_cache_claim(uint16_t K_padded, uint16_t rows) {
+  pthread_mutex_lock(&plan_lock);
+  struct plan *p = plan_cache_find(K_padded);
+  while (p && p->pending) {
+    pthread_cond_wait(&plan_ready, &plan_lock);
+    p = plan_cache_find(K_padded);
+  }
+  if (p == NULL) {
+    p = plan_new(K_padded, rows);
+    p->pending = true;
+    kv_push(struct plan *, plan_cache, p);
+  }
+  pthread_mutex_unlock(&plan_lock);
+  return p;
+}
+
+/* makes a claimed plan available, or drops it when its solve failed */
+struct plan *plan_cache_publish(struct plan *p, bool success) {
+  pthread_mutex_lock(&plan_lock);
+  if (success) {
+    p->pending = false;
+  } else {
+    for (size_t idx = 0; idx < kv_size(plan_cache); idx++) {
+      if (kv_A(plan_cache, idx) == p) {
+        kv_A(plan_cache, idx) = kv_pop(plan_cache);
+        break;
+      }
+    }
+    plan_free(p);
+    p = NULL;
+  }
+  pthread_cond_broadcast(&plan_ready);
+  pthread_mutex_unlock(&plan_lock);
+  return p;
+}
+
+void plan_cache_clear(void) {
+  pthread_mutex_lock(&plan_lock);
+  for (size_t idx = 0; idx < kv_size(plan_cache); idx++) {
+    plan_free(kv_A(plan_cache, idx));
+  }
+  kv_destroy(plan_cache);
+  kv_init(plan_cache);
+
+  for (size_t idx = 0; idx < kv_size(plan_mappings); idx++) {
+    munmap(kv_A(plan_mappings, idx).base, kv_A(plan_mappings, idx).size);
+  }
+  kv_destroy(plan_mappings);
+  kv_init(plan_mappings);
+  pthread_mutex_unlock(&plan_lock);
+}
+
+static uint64_t plan_catalog_size(struct plan *p) {
+  uint64_t size = kv_size(p->ops) * sizeof(struct plan_op) +
+                  kv_size(p->c) * sizeof(uint16_t);
+  return (size + 7) & ~7ULL;
+}
+
+bool plan_catalog_write(const char *path, struct plan **plans, size_t count) {
+  struct plan_catalog_hdr hdr = {PLAN_CATALOG_MAGIC, PLAN_CATALOG_VERSION,
+                                 (uint16_t)count};
+  uint64_t offset = sizeof(hdr) + count * sizeof(struct plan_catalog_entry);
+  uint8_t pad[8] = {0};
+  bool ok = true;
+
+  FILE *fp = fopen(path, "w");
+  if (!fp)
+    return false;
+
+  ok &= (fwrite(&hdr, sizeof(hdr), 1, fp) == 1);
+  for (size_t idx = 0; idx < count; idx++) {
+    struct plan *p = plans[idx];
+    struct plan_catalog_entry e = {p->K_padded, p->rows,
+                                   (uint32_t)kv_size(p->ops), offset};
+    ok &= (fwrite(&e, sizeof(e), 1, fp) == 1);
+    offset += plan_catalog_size(p);
+  }
+  for (size_t idx = 0; idx < count; idx++) {
+    struct plan *p = plans[idx];
+    size_t len = kv_size(p->ops) * sizeof(struct plan_op) +
+                 kv_size(p->c) * sizeof(uint16_t);
+    ok &= (fwrite(p->ops.a, sizeof(struct plan_op), kv_size(p->ops), fp) ==
+           kv_size(p->ops));
+    ok &= (fwrite(p->c.a, sizeof(uint16_t), kv_size(p->c), fp) ==
+           kv_size(p->c));
+    ok &= (fwrite(pad, 1, plan_catalog_size(p) - len, fp) ==
+           plan_catalog_size(p) - len);
+  }
+  ok &= (fclose(fp) == 0);
+
+  return ok;
+}
+
+/* checks an entry against the parameters of its K' and that every op and
+ * column stays inside the rows, the data is used in place unchecked later */
+static bool plan_catalog_check(struct plan_catalog_entry *e, uint8_t *base,
+                               size_t size) {
+  if (e->K_padded == 0 || e->K_padded > K_max)
+    return false;
+  struct pparams prm = params_init(e->K_padded);
+  if (prm.K_padded != e->K_padded || prm.L != e->rows)
+    return false;
+
+  uint64_t len = (uint64_t)e->num_ops * sizeof(struct plan_op) +
+                 e->rows * sizeof(uint16_t);
+  if (e->offset % 8 != 0 || e->offset > size || len > size - e->offset)
+    return false;
+
+  struct plan_op *ops = (struct plan_op *)(base + e->offset);
+  for (uint32_t idx = 0; idx < e->num_ops; idx++) {
+    if (ops[idx].type > PLAN_AXPY || ops[idx].dst >= e->rows ||
+        ops[idx].src >= e->rows)
+      return false;
+  }
+  uint16_t *c = (uint16_t *)(ops + e->num_ops);
+  for (uint16_t idx = 0; idx < e->rows; idx++) {
+    if (c[idx] >= e->rows)
+      return false;
+  }
+  return true;
+}
+
+/* maps a catalog into the cache, a file with any bad entry is rejected */
+bool plan_catalog_load(const char *path) {
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  if (fstat(fd, &st) != 0 || st.st_size < sizeof(struct plan_catalog_hdr)) {
+    close(fd);
+    return false;
+  }
+
+  size_t size = st.st_size;
+  uint8_t *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return false;
+
+  struct plan_catalog_hdr *hdr = (struct plan_catalog_hdr *)base;
+  struct plan_catalog_entry *entries =
+      (struct plan_catalog_entry *)(base + sizeof(*hdr));
+  bool ok = (hdr->magic == PLAN_CATALOG_MAGIC &&
+             hdr->version == PLAN_CATALOG_VERSION &&
+             sizeof(*hdr) + hdr->count * sizeof(*entries) <= size);
+  for (int idx = 0; ok && idx < hdr->count; idx++) {
+    ok = plan_catalog_check(&entries[idx], base, size);
+  }
+  if (!ok) {
+    munmap(base, size);
+    return false;
+  }
+
+  pthread_mutex_lock(&plan_lock);
+  for (int idx = 0; idx < hdr->count; idx++) {
+    struct plan_catalog_entry *e = &entries[idx];
+    if (plan_cache_find(e->K_padded) != NULL)
+      continue;
+
+    struct plan *p = plan_new(e->K_padded, e->rows);
+    p->mapped = true;
+    p->ops.a = (struct plan_op *)(base + e->offset);
+    p->ops.n = e->num_ops;
+    p->c.a = (uint16_t *)(base + e->offset +
+                          e->num_ops * sizeof(struct plan_op));
+    p->c.n = e->rows;
+    plan_cache_insert(p);
+  }
+
+  struct plan_mapping m = {base, size};
+  kv_push(struct plan_mapping, plan_mappings, m);
+  pthread_mutex_unlock(&plan_lock);
+  return true;
+}
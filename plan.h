@@ -0,0 +1,47 @@
+#ifndef NANORQ_PLAN_H
+#define NANORQ_PLAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pool.h"
+#include "util.h"
+
+enum plan_op_type { PLAN_SWAP, PLAN_SCAL, PLAN_AXPY };
+
+struct plan_op {
+  uint8_t type;
+  uint8_t beta;
+  uint16_t dst;
+  uint16_t src;
+};
+
+/*
+ * the row operations the solver applied to D for a given K', along with the
+ * final column order. for encoders A only depends on K', so replaying the
+ * plan on D yields the same intermediate symbols as solving again.
+ */
+struct plan {
+  uint16_t K_padded;
+  uint16_t rows;
+  kvec_t(struct plan_op) ops;
+  uint16_vec c;
+  bool mapped;  /* ops and c point into a mapped catalog */
+  bool pending; /* claimed, still being solved */
+};
+
+struct plan *plan_new(uint16_t K_padded, uint16_t rows);
+void plan_add(struct plan *p, uint8_t type, uint16_t dst, uint16_t src,
+              uint8_t beta);
+void plan_apply(struct plan *p, octmat *D, struct pool *pool);
+void plan_free(struct plan *p);
+
+struct plan *plan_cache_claim(uint16_t K_padded, uint16_t rows);
+struct plan *plan_cache_publish(struct plan *p, bool success);
+void plan_cache_clear(void);
+
+bool plan_catalog_write(const char *path, struct plan **plans, size_t count);
+bool plan_catalog_load(const char *path);
+
+#endif
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <nanorq.h>
+
+/*
+ * times the numeric pass of the encoder, the solve plan of the block is
+ * cached by a first solve so every later one replays it. the replay is
+ * split over threads threads, 1 replays D whole.
+ */
+
+static double secs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+void usage(char *prog) {
+  fprintf(stderr, "usage:\n%s <symbols> <symbol_size> <rounds> [threads]\n",
+          prog);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4)
+    usage(argv[0]);
+
+  uint16_t K = strtol(argv[1], NULL, 10);
+  uint16_t T = strtol(argv[2], NULL, 10);
+  int rounds = strtol(argv[3], NULL, 10);
+  int threads = (argc > 4) ? strtol(argv[4], NULL, 10) : 1;
+  size_t len = (size_t)K * T;
+
+  uint8_t *data = malloc(len);
+  for (size_t i = 0; i < len; i++) {
+    data[i] = rand();
+  }
+  struct ioctx *myio = ioctx_from_mem(data, len);
+  nanorq *rq = nanorq_encoder_new_ex(len, T, K, 0, 8);
+  if (rq != NULL)
+    nanorq_set_block_threads(rq, threads);
+  if (rq == NULL || !nanorq_generate_symbols(rq, 0, myio)) {
+    fprintf(stderr, "Could not solve a block of %d symbols.\n", K);
+    return -1;
+  }
+
+  double best = 0;
+  for (int round = 0; round < rounds; round++) {
+    nanorq_encode_cleanup(rq, 0);
+    double start = secs();
+    nanorq_generate_symbols(rq, 0, myio);
+    double took = secs() - start;
+    if (round == 0 || took < best)
+      best = took;
+  }
+  printf("REPLAY | K: %d, T: %d, threads: %d, best of %d: %.4fs, %.1f MB/s\n",
+         K, T, threads, rounds, best, len / best / (1024 * 1024));
+
+  nanorq_free(rq);
+  myio->destroy(myio);
+  free(data);
+  return 0;
+}
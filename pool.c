@@ -0,0 +1,98 @@
+#include <stdlib.h>
+
+#include "pool.h"
+
+/* runs the next item of the job, called and returns with lock held */
+static void pool_take(struct pool *pool) {
+  void (*fn)(void *, int) = pool->fn;
+  void *arg = pool->arg;
+  int idx = pool->next++;
+
+  pool->running++;
+  pthread_mutex_unlock(&pool->lock);
+  fn(arg, idx);
+  pthread_mutex_lock(&pool->lock);
+  if (--pool->running == 0 && pool->next >= pool->count)
+    pthread_cond_signal(&pool->done);
+}
+
+static void *pool_worker(void *arg) {
+  struct pool *pool = arg;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->quit && pool->next >= pool->count)
+      pthread_cond_wait(&pool->work, &pool->lock);
+    if (pool->quit)
+      break;
+    pool_take(pool);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+/* threads counts the caller of pool_run, so threads - 1 workers start */
+struct pool *pool_new(int threads) {
+  struct pool *pool = calloc(1, sizeof(struct pool));
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  if (threads > 1)
+    pool->tids = calloc(threads - 1, sizeof(pthread_t));
+  for (; pool->workers < threads - 1; pool->workers++) {
+    if (pthread_create(&pool->tids[pool->workers], NULL, pool_worker, pool) !=
+        0)
+      break;
+  }
+  return pool;
+}
+
+int pool_threads(struct pool *pool) { return pool ? pool->workers + 1 : 1; }
+
+void pool_run(struct pool *pool, void (*fn)(void *, int), void *arg,
+              int count) {
+  bool shared = false;
+
+  if (pool && pool->workers > 0 && count > 1) {
+    pthread_mutex_lock(&pool->lock);
+    shared = !pool->busy;
+    if (shared) {
+      pool->busy = true;
+      pool->fn = fn;
+      pool->arg = arg;
+      pool->count = count;
+      pool->next = 0;
+      pthread_cond_broadcast(&pool->work);
+      while (pool->next < pool->count)
+        pool_take(pool);
+      while (pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+      pool->count = pool->next = 0;
+      pool->busy = false;
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+  if (!shared) {
+    for (int idx = 0; idx < count; idx++) {
+      fn(arg, idx);
+    }
+  }
+}
+
+void pool_free(struct pool *pool) {
+  if (pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (int t = 0; t < pool->workers; t++) {
+      pthread_join(pool->tids[t], NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->tids);
+    free(pool);
+  }
+}
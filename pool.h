@@ -0,0 +1,34 @@
+#ifndef NANORQ_POOL_H
+#define NANORQ_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/*
+ * a fixed set of worker threads that runs one job at a time. a job is count
+ * items handed out in order, the thread that posts it works through them
+ * too. a job posted while another runs, as from inside an item, runs on
+ * the posting thread alone so nested use can't deadlock.
+ */
+struct pool {
+  pthread_mutex_t lock;
+  pthread_cond_t work; /* a job was posted or the pool is closing */
+  pthread_cond_t done; /* the last item of the job finished */
+  pthread_t *tids;
+  int workers;
+  void (*fn)(void *, int);
+  void *arg;
+  int count;   /* items of the job */
+  int next;    /* next item to hand out */
+  int running; /* items being worked on */
+  bool busy;
+  bool quit;
+};
+
+struct pool *pool_new(int threads);
+int pool_threads(struct pool *pool);
+void pool_run(struct pool *pool, void (*fn)(void *, int), void *arg,
+              int count);
+void pool_free(struct pool *pool);
+
+#endif
@@ -6,117 +6,314 @@
 
 #include "bitmask.h"
 #include "chooser.h"
+#include "gf256.h"
 #include "graph.h"
 #include "params.h"
+#include "plan.h"
 #include "precode.h"
 #include "rand.h"
 
-static void precode_matrix_init_LDPC1(octmat *A, uint16_t S, uint16_t B) {
-  int row, col;
-  for (row = 0; row < S; row++) {
-    for (col = 0; col < B; col++) {
-      uint16_t submtx = col / S;
-      if ((row == (col % S)) || (row == (col + submtx + 1) % S) ||
-          (row == (col + 2 * (submtx + 1)) % S)) {
-        om_A((*A), row, col) = 1;
-      }
-    }
+#define PHASE2_PANEL 16
+/* bytes of outputs a batch encode builds together. a chunk is never under
+ * L outputs though, so for large blocks it is tens of MB and the outputs
+ * are not cache resident, what it saves is reading each row of C once per
+ * chunk instead of once per output using it */
+#define ENCODE_CHUNK_BYTES (256 * 1024)
+/* symbols up to this size are encoded one at a time even in a batch */
+#define ENCODE_DIRECT_BYTES 128
+
+/*
+ * working state of the solver, A is never modified while solving. rows of D
+ * and U are swapped physically, rows of A are looked up through rid and its
+ * columns through c / cpos. inactivated columns live in the dense U block,
+ * U slot s is A column position L - 1 - s.
+ */
+struct solver {
+  struct pparams *prm;
+  struct cmat *A;
+  struct spmat *AT;
+  struct plan *plan;
+  octmat U;
+  uint16_t *rid;     /* original row at each position */
+  uint16_t *rpos;    /* position of each original row */
+  uint16_t *flushed; /* U slots already folded into U, per original row */
+  uint16_vec c;      /* original column at each position */
+  uint16_t *cpos;    /* position of each original column */
+  uint8_t *mark;
+  kvec_t(struct plan_op) log; /* phase 1 eliminations, by original row */
+  uint16_t rows;
+  uint16_t i;
+  uint16_t u;
+};
+
+static void precode_matrix_init_LDPC1(struct cmat *A, uint16_t S, uint16_t B) {
+  for (int col = 0; col < B; col++) {
+    uint16_t submtx = col / S;
+    spmat_set(A->sp, col % S, col);
+    spmat_set(A->sp, (col + submtx + 1) % S, col);
+    spmat_set(A->sp, (col + 2 * (submtx + 1)) % S, col);
   }
 }
 
-static void precode_matrix_init_LDPC2(octmat *A, uint16_t skip, uint16_t rows,
-                                      uint16_t cols) {
+static void precode_matrix_init_LDPC2(struct cmat *A, uint16_t skip,
+                                      uint16_t rows, uint16_t cols) {
   for (int row = 0; row < rows; row++) {
     uint16_t start = row % cols;
-    for (int col = 0; col < cols; col++) {
-      uint8_t val = (col == start || col == (start + 1) % cols) > 0;
-      om_A((*A), row, skip + col) = val;
-    }
+    spmat_set(A->sp, row, skip + start);
+    spmat_set(A->sp, row, skip + (start + 1) % cols);
   }
 }
 
-static void precode_matrix_add_identity(octmat *A, uint16_t size,
+static void precode_matrix_add_identity(struct cmat *A, uint16_t size,
                                         uint16_t skip_row, uint16_t skip_col) {
   for (int diag = 0; diag < size; diag++) {
-    om_A((*A), skip_row + diag, skip_col + diag) = 1;
+    spmat_set(A->sp, skip_row + diag, skip_col + diag);
   }
 }
 
-static octmat precode_matrix_make_MT(uint16_t rows, uint16_t cols) {
-  octmat MT = OM_INITIAL;
-  om_resize(&MT, rows, cols);
+/*
+ * HDPC = MT x GAMMA with GAMMA[j][c] = alpha^(j - c) for j >= c, so column c
+ * of a row is MT[c] + alpha * (column c + 1). MT has a one in two rows per
+ * column and alpha^row in the last, walking the columns backwards builds the
+ * rows in O(H n) without either matrix.
+ */
+static void precode_matrix_init_HDPC(struct pparams *prm, struct cmat *A) {
+  uint16_t m = prm->H;
+  uint16_t n = prm->K_padded + prm->S;
 
-  for (int row = 0; row < MT.rows; row++) {
-    int col;
-    for (col = 0; col < MT.cols - 1; col++) {
-      uint32_t tmp = rnd_get(col + 1, 6, MT.rows);
-      if ((row == tmp) ||
-          (row == (tmp + rnd_get(col + 1, 7, MT.rows - 1) + 1) % MT.rows)) {
-        om_A(MT, row, col) = 1;
-      } else {
-        om_A(MT, row, col) = 0;
-      }
+  if (m == 0 || n == 0)
+    return;
+
+  for (int row = 0; row < m; row++) {
+    om_A(A->hdpc, row, n - 1) = OCT_EXP[row];
+  }
+  for (int col = n - 2; col >= 0; col--) {
+    for (int row = 0; row < m; row++) {
+      uint8_t prev = om_A(A->hdpc, row, col + 1);
+      om_A(A->hdpc, row, col) = OCTET_MUL(prev, OCT_EXP[1]);
     }
-    om_A(MT, row, col) = OCT_EXP[row];
+    uint32_t a = rnd_get(col + 1, 6, m);
+    uint32_t b = (a + rnd_get(col + 1, 7, m - 1) + 1) % m;
+    om_A(A->hdpc, a, col) ^= 1;
+    om_A(A->hdpc, b, col) ^= 1;
   }
-  return MT;
 }
 
-static octmat precode_matrix_make_GAMMA(uint16_t dim) {
-  octmat GAMMA = OM_INITIAL;
-  om_resize(&GAMMA, dim, dim);
-
-  for (int row = 0; row < GAMMA.rows; row++) {
-    int col;
-    for (col = 0; col <= row; col++)
-      om_A(GAMMA, row, col) = OCT_EXP[(row - col) % OCT_EXP_SIZE];
-    for (; col < GAMMA.cols; col++) {
-      om_A(GAMMA, row, col) = 0;
+static void precode_matrix_add_G_ENC(struct pparams *prm, struct cmat *A) {
+  for (int row = prm->S + prm->H; row < prm->L; row++) {
+    uint32_t isi = (row - prm->S) - prm->H;
+    struct params_idxs t = params_get_idxs(prm, isi);
+    for (int idx = 0; idx < t.len; idx++) {
+      spmat_set(A->sp, row, t.idx[idx]);
     }
   }
-  return GAMMA;
 }
 
-static void precode_matrix_init_HDPC(struct pparams *prm, octmat *A) {
-  uint16_t m = prm->H;
-  uint16_t n = prm->K_padded + prm->S;
+static bool solver_is_hdpc(struct solver *s, uint16_t row) {
+  return (row >= s->prm->S && row < (s->prm->S + s->prm->H));
+}
 
-  if (m == 0 || n == 0)
+/* HDPC rows stay in original column order, positions go through c */
+static uint8_t solver_hdpc_at(struct solver *s, uint16_t row, uint16_t pos) {
+  return om_A(s->A->hdpc, row - s->prm->S, kv_A(s->c, pos));
+}
+
+/* row operations on D are only recorded while solving A, the numeric pass
+ * applies them afterwards */
+static void solver_d_swap(struct solver *s, uint16_t a, uint16_t b) {
+  plan_add(s->plan, PLAN_SWAP, a, b, 0);
+}
+
+static void solver_d_scal(struct solver *s, uint16_t row, uint8_t beta) {
+  plan_add(s->plan, PLAN_SCAL, row, row, beta);
+}
+
+static void solver_d_axpy(struct solver *s, uint16_t dst, uint16_t src,
+                          uint8_t beta) {
+  plan_add(s->plan, PLAN_AXPY, dst, src, beta);
+}
+
+static void solver_swap_rows(struct solver *s, uint16_t a, uint16_t b) {
+  if (a == b)
+    return;
+  oswaprow(om_P(s->U), a, b, s->U.cols);
+  solver_d_swap(s, a, b);
+
+  uint16_t tmp = s->rid[a];
+  s->rid[a] = s->rid[b];
+  s->rid[b] = tmp;
+  s->rpos[s->rid[a]] = a;
+  s->rpos[s->rid[b]] = b;
+}
+
+static void solver_swap_cols(struct solver *s, uint16_t a, uint16_t b) {
+  if (a == b)
     return;
+  kv_swap(uint16_t, s->c, a, b);
+  s->cpos[kv_A(s->c, a)] = a;
+  s->cpos[kv_A(s->c, b)] = b;
+}
 
-  octmat MT = precode_matrix_make_MT(m, n);
-  octmat GAMMA = precode_matrix_make_GAMMA(n);
-  octmat MTxGAMMA = OM_INITIAL;
+static void solver_grow_u(struct solver *s, uint16_t u) {
+  if (u <= s->U.cols)
+    return;
 
-  om_resize(&MTxGAMMA, MT.rows, GAMMA.cols);
+  uint16_t cols = (s->U.cols * 2 > u) ? s->U.cols * 2 : u;
+  octmat U = OM_INITIAL;
+  om_resize(&U, s->U.rows, (cols > s->prm->L) ? s->prm->L : cols);
+  for (int row = 0; row < U.rows; row++) {
+    memcpy(om_R(U, row), om_R(s->U, row), s->U.cols);
+  }
+  om_destroy(&s->U);
+  s->U = U;
+}
 
-  ogemm(om_P(MT), om_P(GAMMA), om_P(MTxGAMMA), MT.rows, MT.cols, GAMMA.cols);
+/* fold the entries of A that moved into U since the last flush into U */
+static void solver_flush(struct solver *s, uint16_t pos) {
+  uint16_t row = s->rid[pos];
+  uint16_t L = s->prm->L;
+  uint8_t *dst = om_R(s->U, pos);
 
-  int row, col;
-  for (col = 0; col < GAMMA.cols; col++) {
-    for (row = 0; row < MT.rows; row++) {
-      om_A(*A, prm->S + row, col) = om_A(MTxGAMMA, row, col);
+  if (s->flushed[row] == s->u)
+    return;
+
+  if (solver_is_hdpc(s, row)) {
+    for (int slot = s->flushed[row]; slot < s->u; slot++) {
+      dst[slot] ^= solver_hdpc_at(s, row, L - 1 - slot);
+    }
+  } else {
+    uint16_vec *idxs = &s->A->sp->idxs[row];
+    for (int idx = 0; idx < kv_size(*idxs); idx++) {
+      int slot = L - 1 - s->cpos[kv_A(*idxs, idx)];
+      if (slot >= s->flushed[row] && slot < s->u)
+        dst[slot] ^= 1;
     }
   }
-  om_destroy(&MT);
-  om_destroy(&GAMMA);
-  om_destroy(&MTxGAMMA);
+  s->flushed[row] = s->u;
 }
 
-static void precode_matrix_add_G_ENC(struct pparams *prm, octmat *A) {
-  for (int row = prm->S + prm->H; row < prm->L; row++) {
-    uint32_t isi = (row - prm->S) - prm->H;
-    uint16_vec idxs = params_get_idxs(prm, isi);
-    for (int idx = 0; idx < kv_size(idxs); idx++) {
-      om_A(*A, row, kv_A(idxs, idx)) = 1;
+/* nonzeros of the row at pos inside V */
+static uint16_t solver_row_degree(struct solver *s, uint16_t pos) {
+  uint16_t row = s->rid[pos];
+  uint16_t v_end = s->prm->L - s->u;
+  uint16_t nnz = 0;
+
+  if (solver_is_hdpc(s, row)) {
+    for (int col = s->i; col < v_end; col++) {
+      nnz += (solver_hdpc_at(s, row, col) != 0);
+    }
+  } else {
+    uint16_vec *idxs = &s->A->sp->idxs[row];
+    for (int idx = 0; idx < kv_size(*idxs); idx++) {
+      uint16_t col = s->cpos[kv_A(*idxs, idx)];
+      nnz += (col >= s->i && col < v_end);
     }
-    kv_destroy(idxs);
   }
+  return nnz;
 }
 
-static void decode_phase0(struct pparams *prm, octmat *A, struct bitmask *mask,
-                          repair_vec *repair_bin, uint16_t num_symbols,
-                          uint16_t overhead) {
+/* V relative columns of the two ones of a sparse row with two nonzeros */
+static void solver_row_ones(struct solver *s, uint16_t row,
+                            uint16_t ones_idx[2]) {
+  uint16_t v_end = s->prm->L - s->u;
+  uint16_vec *idxs = &s->A->sp->idxs[row];
+  int ones = 0;
+
+  for (int idx = 0; idx < kv_size(*idxs) && ones < 2; idx++) {
+    uint16_t col = s->cpos[kv_A(*idxs, idx)];
+    if (col >= s->i && col < v_end)
+      ones_idx[ones++] = col - s->i;
+  }
+}
+
+/* the column at pos leaves V, rows below the pivot lose a nonzero */
+static void solver_retire_col(struct solver *s, struct chooser *ch,
+                              uint16_t pos) {
+  uint16_vec *col_rows = &s->AT->idxs[kv_A(s->c, pos)];
+
+  for (int idx = 0; idx < kv_size(*col_rows); idx++) {
+    uint16_t row = kv_A(*col_rows, idx);
+    if (s->rpos[row] > s->i)
+      chooser_decrement(ch, row);
+  }
+  for (int row = s->prm->S; row < s->prm->S + s->prm->H; row++) {
+    if (s->rpos[row] > s->i && solver_hdpc_at(s, row, pos) != 0)
+      chooser_decrement(ch, row);
+  }
+}
+
+/* move the columns of the pivot row into place, first one at position i and
+ * the remaining non_zero - 1 to the right edge of V */
+static void solver_place_cols(struct solver *s, uint16_t non_zero) {
+  uint16_t row = s->rid[s->i];
+  uint16_t v_end = s->prm->L - s->u;
+  uint16_t lo = v_end - (non_zero - 1);
+  uint16_vec cols;
+
+  kv_init(cols);
+  if (solver_is_hdpc(s, row)) {
+    for (int col = s->i; col < v_end; col++) {
+      if (solver_hdpc_at(s, row, col) != 0)
+        kv_push(uint16_t, cols, kv_A(s->c, col));
+    }
+  } else {
+    uint16_vec *idxs = &s->A->sp->idxs[row];
+    for (int idx = 0; idx < kv_size(*idxs); idx++) {
+      uint16_t col = s->cpos[kv_A(*idxs, idx)];
+      if (col >= s->i && col < v_end)
+        kv_push(uint16_t, cols, kv_A(*idxs, idx));
+    }
+  }
+
+  int first = 0;
+  for (int idx = 1; idx < kv_size(cols); idx++) {
+    if (s->cpos[kv_A(cols, idx)] < s->cpos[kv_A(cols, first)])
+      first = idx;
+  }
+  solver_swap_cols(s, s->i, s->cpos[kv_A(cols, first)]);
+
+  for (int idx = 0; idx < kv_size(cols); idx++) {
+    if (idx != first)
+      s->mark[kv_A(cols, idx)] = 1;
+  }
+  uint16_t swap = lo;
+  for (int idx = 0; idx < kv_size(cols); idx++) {
+    uint16_t col = kv_A(cols, idx);
+    if (idx == first || s->cpos[col] >= lo)
+      continue;
+    while (s->mark[kv_A(s->c, swap)])
+      swap++;
+    solver_swap_cols(s, s->cpos[col], swap);
+  }
+  for (int idx = 0; idx < kv_size(cols); idx++) {
+    s->mark[kv_A(cols, idx)] = 0;
+  }
+  kv_destroy(cols);
+}
+
+static uint8_t solver_pivot_value(struct solver *s, uint16_t pos,
+                                  uint16_t col) {
+  uint16_t row = s->rid[pos];
+  if (solver_is_hdpc(s, row))
+    return solver_hdpc_at(s, row, col);
+  return 1;
+}
+
+static void solver_eliminate(struct solver *s, uint16_t pos, uint8_t mnum,
+                             uint8_t mden) {
+  uint8_t multiple = (mnum > 0 && mden > 0) ? OCTET_DIV(mnum, mden) : 0;
+  if (multiple == 0)
+    return;
+  gf256_axpy(om_R(s->U, pos), om_R(s->U, s->i), s->U.cols, multiple);
+  solver_d_axpy(s, pos, s->i, multiple);
+
+  struct plan_op op = {PLAN_AXPY, multiple, s->rid[pos], s->rid[s->i]};
+  kv_push(struct plan_op, s->log, op);
+}
+
+static void decode_phase0(struct pparams *prm, struct cmat *A,
+                          struct bitmask *mask, repair_vec *repair_bin,
+                          uint16_t num_symbols, uint16_t overhead) {
 
   size_t padding = prm->K_padded - num_symbols;
   uint16_t num_gaps = bitmask_gaps(mask, num_symbols);
@@ -125,389 +322,590 @@ static void decode_phase0(struct pparams *prm, octmat *A, struct bitmask *mask,
     if (bitmask_check(mask, gap))
       continue;
     uint16_t row = gap + prm->H + prm->S;
-    for (int col = 0; col < A->cols; col++) {
-      om_A(*A, row, col) = 0;
-    }
+    spmat_clear_row(A->sp, row);
 
-    uint16_vec idxs =
+    struct params_idxs t =
         params_get_idxs(prm, kv_A(*repair_bin, rep_idx++).esi + padding);
-    for (int idx = 0; idx < kv_size(idxs); idx++) {
-      om_A(*A, row, kv_A(idxs, idx)) = 1;
+    for (int idx = 0; idx < t.len; idx++) {
+      spmat_set(A->sp, row, t.idx[idx]);
     }
-    kv_destroy(idxs);
     num_gaps--;
   }
 
-  int rep_row = (uint16_t)(A->rows - overhead);
-  for (; rep_row < A->rows; rep_row++) {
-    for (int col = 0; col < A->cols; col++) {
-      om_A(*A, rep_row, col) = 0;
-    }
-    uint16_vec idxs =
+  int rep_row = (uint16_t)(A->sp->rows - overhead);
+  for (; rep_row < A->sp->rows; rep_row++) {
+    spmat_clear_row(A->sp, rep_row);
+    struct params_idxs t =
         params_get_idxs(prm, kv_A(*repair_bin, rep_idx++).esi + padding);
-    for (int idx = 0; idx < kv_size(idxs); idx++) {
-      om_A(*A, rep_row, kv_A(idxs, idx)) = 1;
+    for (int idx = 0; idx < t.len; idx++) {
+      spmat_set(A->sp, rep_row, t.idx[idx]);
     }
-    kv_destroy(idxs);
   }
 }
 
-static bool decode_phase1(struct pparams *prm, octmat *A, octmat *X, octmat *D,
-                          uint16_vec c, uint16_t *i_val, uint16_t *u_val) {
-  uint16_t i = 0;
-  uint16_t u = prm->P;
+static bool decode_phase1(struct solver *s) {
+  struct pparams *prm = s->prm;
+  struct chooser ch = chooser_init(s->rows);
+  struct graph *G = graph_new(prm->L);
 
-  struct chooser ch = chooser_init(A->rows);
-
-  for (int row = 0; row < A->rows; row++) {
-    bool is_hdpc = (row >= prm->S && row < (prm->S + prm->H));
-    size_t row_degree = 0;
-    for (int col = 0; col < A->cols - u; col++) {
-      row_degree += (uint8_t)(om_A(*A, row, col));
-    }
-    chooser_add_tracking_pair(&ch, is_hdpc, row_degree);
+  for (int row = 0; row < s->rows; row++) {
+    chooser_add_tracking_pair(&ch, solver_is_hdpc(s, row),
+                              solver_row_degree(s, row));
   }
 
-  while (i + u < prm->L) {
-    uint16_t sub_rows = A->rows - i;
-    uint16_t sub_cols = A->cols - i - u;
+  while (s->i + s->u < prm->L) {
+    uint16_t i = s->i;
+    uint16_t v_end = prm->L - s->u;
     uint16_t chosen, non_zero;
-    struct graph *G = graph_new(sub_cols);
 
-    non_zero = chooser_non_zero(&ch, A, G, i, sub_rows, sub_cols);
-    if (non_zero == sub_cols + 1) {
+    non_zero = chooser_non_zero(&ch);
+    if (non_zero == 0) {
       chooser_clear(&ch);
       graph_free(G);
-
-      *i_val = 0;
-      *u_val = 0;
       return false;
     }
-    chosen = chooser_pick(&ch, G, i, sub_rows, non_zero);
-    if (chosen != 0) {
-      oswaprow(om_P(*A), i, chosen + i, A->cols);
-      oswaprow(om_P(*X), i, chosen + i, X->cols);
-      oswaprow(om_P(*D), i, chosen + i, D->cols);
-
-      kv_swap(struct tracking_pair, ch.tracking, i, chosen + i);
-    }
-
-    if (om_A(*A, i, i) == 0) {
-      int idx = 1;
-      for (; idx < sub_cols; idx++) {
-        if (om_A(*A, i, idx + i) != 0)
-          break;
+    /*
+     * the graph is rebuilt rather than kept up to date: columns leaving V
+     * shrink or split components and union-find can't delete. it only
+     * happens on steps where the fewest ones is two, each of which starts
+     * peeling a component off through r = 1 steps, so a handful per solve.
+     */
+    if (ch.only_two_ones) {
+      graph_reset(G);
+      for (size_t rp_idx = 0; rp_idx < kv_size(ch.r_rows); rp_idx++) {
+        struct pair *rp = &kv_A(ch.r_rows, rp_idx);
+        uint16_t ones_idx[2];
+        solver_row_ones(s, rp->first, ones_idx);
+        graph_link(G, ones_idx[0], ones_idx[1]);
+        rp->second = ones_idx[0];
       }
-
-      oswapcol(om_P(*A), i, i + idx, A->rows, A->cols);
-      oswapcol(om_P(*X), i, i + idx, X->rows, X->cols);
-
-      kv_swap(uint16_t, c, i, i + idx);
     }
-    int col = sub_cols - 1;
-    int swap = 1;
-    for (; col > sub_cols - non_zero; col--) {
-      if (om_A(*A, i, col + i) != 0)
-        continue;
-      while (swap < col && om_A(*A, i, swap + i) == 0) {
-        swap++;
-      }
-
-      if (swap >= col)
-        break;
-
-      oswapcol(om_P(*A), col + i, swap + i, A->rows, A->cols);
-      oswapcol(om_P(*X), col + i, swap + i, X->rows, X->cols);
-
-      kv_swap(uint16_t, c, col + i, swap + i);
+    chosen = chooser_pick(&ch, G, non_zero);
+    chooser_remove(&ch, chosen);
+    solver_swap_rows(s, i, s->rpos[chosen]);
+
+    solver_place_cols(s, non_zero);
+    solver_grow_u(s, s->u + non_zero - 1);
+    s->u += non_zero - 1;
+    solver_flush(s, i);
+
+    solver_retire_col(s, &ch, i);
+    for (int col = prm->L - s->u; col < v_end; col++) {
+      solver_retire_col(s, &ch, col);
     }
 
-    for (int row = 1; row < sub_rows; row++) {
-      if (om_A(*A, row + i, i) != 0) {
-        uint8_t mnum = om_A(*A, row + i, i);
-        uint8_t mden = om_A(*A, i, i);
-        uint8_t multiple = (mnum > 0 && mden > 0) ? OCTET_DIV(mnum, mden) : 0;
-        if (multiple == 0)
-          continue;
-        oaxpy(om_P(*A), om_P(*A), row + i, i, A->cols, multiple);
-        oaxpy(om_P(*D), om_P(*D), row + i, i, D->cols, multiple);
-      }
+    uint16_t col = kv_A(s->c, i);
+    uint8_t mden = solver_pivot_value(s, i, i);
+    uint16_vec *col_rows = &s->AT->idxs[col];
+    for (int idx = 0; idx < kv_size(*col_rows); idx++) {
+      uint16_t pos = s->rpos[kv_A(*col_rows, idx)];
+      if (pos > i)
+        solver_eliminate(s, pos, 1, mden);
     }
-    i++;
-    u += non_zero - 1;
-
-    graph_free(G);
+    for (int row = prm->S; row < prm->S + prm->H; row++) {
+      uint16_t pos = s->rpos[row];
+      if (pos > i)
+        solver_eliminate(s, pos, solver_hdpc_at(s, row, i), mden);
+    }
+    s->i++;
   }
   chooser_clear(&ch);
+  graph_free(G);
 
-  *i_val = i;
-  *u_val = u;
+  for (int row = 0; row < s->rows; row++) {
+    solver_flush(s, row);
+  }
   return true;
 }
 
-static bool decode_phase2(octmat *A, octmat *D, uint16_t i, uint16_t u,
-                          uint16_t L) {
+/*
+ * D side of one phase 2 panel. phys are the D rows (relative to i) the
+ * panel started with, piv[p] the one that became pivot p and mult[p] the
+ * multiples pivot p was added with. pivot rows get the updates that came
+ * before their own step first, then every other row takes all of the panel
+ * in one go, then the pivots eliminate each other upwards.
+ */
+static void solver_apply_panel(struct solver *s, uint16_t k, uint16_t *piv,
+                               uint8_t *scal, uint8_t *mult, uint16_t *pstep,
+                               uint16_t *perm, uint16_t *loc) {
+  uint16_t i = s->i, n = s->rows - s->i;
+
+  for (int p = 0; p < k; p++) {
+    if (scal[p] != 1)
+      solver_d_scal(s, i + piv[p], scal[p]);
+    for (int q = p + 1; q < k; q++) {
+      uint8_t multiple = mult[p * n + piv[q]];
+      if (multiple != 0)
+        solver_d_axpy(s, i + piv[q], i + piv[p], multiple);
+    }
+  }
+  for (int row = 0; row < n; row++) {
+    if (pstep[row] != UINT16_MAX)
+      continue;
+    for (int p = 0; p < k; p++) {
+      uint8_t multiple = mult[p * n + row];
+      if (multiple != 0)
+        solver_d_axpy(s, i + row, i + piv[p], multiple);
+    }
+  }
+  for (int p = 1; p < k; p++) {
+    for (int q = 0; q < p; q++) {
+      uint8_t multiple = mult[p * n + piv[q]];
+      if (multiple != 0)
+        solver_d_axpy(s, i + piv[q], i + piv[p], multiple);
+    }
+  }
 
-  uint16_t row_start = i, row_end = A->rows;
-  uint16_t col_start = A->cols - u;
+  /* move the D rows to where the panel swapped the U rows, loc tracks where
+   * each row sits and at which row sits at a position */
+  uint16_t *at = loc + n;
+  for (int row = 0; row < n; row++) {
+    loc[row] = at[row] = row;
+  }
+  for (int pos = 0; pos < n; pos++) {
+    uint16_t from = loc[perm[pos]];
+    if (from == pos)
+      continue;
+    solver_d_swap(s, i + pos, i + from);
+    loc[at[pos]] = from;
+    at[from] = at[pos];
+    loc[perm[pos]] = pos;
+    at[pos] = perm[pos];
+  }
+}
 
-  for (int row = row_start; row < row_end; row++) {
-    int row_nonzero = row;
-    int diag = col_start + (row - row_start);
-    if (diag >= L) {
-      break;
+/*
+ * gaussian elimination over the u inactivated columns, PHASE2_PANEL pivots at
+ * a time. U is eliminated row by row as before, the D updates of a panel are
+ * collected and applied afterwards so each D row is visited once per panel.
+ */
+static bool decode_phase2(struct solver *s) {
+  octmat *U = &s->U;
+  uint16_t i = s->i, n = s->rows - s->i;
+  uint16_t piv[PHASE2_PANEL];
+  uint8_t scal[PHASE2_PANEL];
+  uint8_t *mult = calloc((size_t)PHASE2_PANEL * n, sizeof(uint8_t));
+  uint16_t *pstep = calloc(n, sizeof(uint16_t));
+  uint16_t *perm = calloc(n, sizeof(uint16_t));
+  uint16_t *loc = calloc(2 * (size_t)n, sizeof(uint16_t));
+  bool success = true;
+
+  for (int t0 = 0; t0 < s->u && success; t0 += PHASE2_PANEL) {
+    uint16_t k = (s->u - t0 < PHASE2_PANEL) ? s->u - t0 : PHASE2_PANEL;
+
+    memset(mult, 0, (size_t)k * n);
+    for (int row = 0; row < n; row++) {
+      perm[row] = row;
+      pstep[row] = UINT16_MAX;
     }
-    for (; row_nonzero < row_end; row_nonzero++) {
-      if (om_A(*A, row_nonzero, diag) != 0) {
+
+    for (int p = 0; p < k; p++) {
+      uint16_t row = i + t0 + p;
+      /* U slots run right to left */
+      uint16_t diag = s->u - 1 - (t0 + p);
+      int row_nonzero = row;
+      for (; row_nonzero < s->rows; row_nonzero++) {
+        if (om_A(*U, row_nonzero, diag) != 0)
+          break;
+      }
+      if (row_nonzero == s->rows) {
+        success = false;
         break;
       }
-    }
+      if (row != row_nonzero) {
+        oswaprow(om_P(*U), row, row_nonzero, U->cols);
+        uint16_t tmp = perm[row - i];
+        perm[row - i] = perm[row_nonzero - i];
+        perm[row_nonzero - i] = tmp;
+      }
 
-    if (row_nonzero == row_end) {
-      return false;
-    } else if (row != row_nonzero) {
-      oswaprow(om_P(*A), row, row_nonzero, A->cols);
-      oswaprow(om_P(*D), row, row_nonzero, D->cols);
-    }
+      piv[p] = perm[row - i];
+      pstep[piv[p]] = p;
+      scal[p] = 1;
+      if (om_A(*U, row, diag) > 1) {
+        scal[p] = OCTET_DIV(1, om_A(*U, row, diag));
+        gf256_scal(om_R(*U, row), U->cols, scal[p]);
+      }
 
-    if (om_A(*A, row, diag) > 1) {
-      uint8_t multiple = om_A(*A, row, diag);
-      oscal(om_P(*A), row, A->cols, OCTET_DIV(1, multiple));
-      oscal(om_P(*D), row, D->cols, OCTET_DIV(1, multiple));
+      for (int del_row = i; del_row < s->rows; del_row++) {
+        if (del_row == row)
+          continue;
+        uint8_t multiple = om_A(*U, del_row, diag);
+        if (multiple == 0)
+          continue;
+        gf256_axpy(om_R(*U, del_row), om_R(*U, row), U->cols, multiple);
+        mult[p * n + perm[del_row - i]] = multiple;
+      }
     }
 
-    for (int del_row = row_start; del_row < row_end; del_row++) {
-      if (del_row == row)
-        continue;
-      uint8_t multiple = om_A(*A, del_row, diag);
-      if (multiple == 0)
-        continue;
-      oaxpy(om_P(*A), om_P(*A), del_row, row, A->cols, multiple);
-      oaxpy(om_P(*D), om_P(*D), del_row, row, D->cols, multiple);
-    }
+    if (success)
+      solver_apply_panel(s, k, piv, scal, mult, pstep, perm, loc);
   }
-  return true;
-}
 
-static void decode_phase3(octmat *A, octmat *X, octmat *D, uint16_t i) {
-  octmat Xb = OM_INITIAL;
-  octmat Ab = OM_INITIAL;
-  octmat Db = OM_INITIAL;
+  free(mult);
+  free(pstep);
+  free(perm);
+  free(loc);
+  return success;
+}
 
-  om_resize(&Xb, i, i);
-  for (int row = 0; row < i; row++) {
-    for (int col = 0; col < i; col++) {
-      om_A(Xb, row, col) = om_A(*X, row, col);
-    }
+/*
+ * undo the phase 1 eliminations on the upper rows, in reverse order, so they
+ * hold their original, sparse, contents again. the pivot row of an
+ * elimination is never touched after it, so each op is its own inverse.
+ */
+static void decode_phase3(struct solver *s) {
+  for (size_t idx = kv_size(s->log); idx-- > 0;) {
+    struct plan_op *op = &kv_A(s->log, idx);
+    uint16_t dst = s->rpos[op->dst];
+    if (dst < s->i)
+      solver_d_axpy(s, dst, s->rpos[op->src], op->beta);
   }
 
-  om_copy(&Ab, A);
-  om_copy(&Db, D);
-  ogemm(om_P(Xb), om_P(Ab), om_P(*A), i, i, Ab.cols);
-  ogemm(om_P(Xb), om_P(Db), om_P(*D), i, i, Db.cols);
-  om_destroy(&Ab);
-  om_destroy(&Xb);
-  om_destroy(&Db);
+  for (int row = 0; row < s->i; row++) {
+    memset(om_R(s->U, row), 0, s->U.cols);
+    s->flushed[s->rid[row]] = 0;
+    solver_flush(s, row);
+  }
 }
 
-static void decode_phase4(octmat *A, octmat *D, uint16_t i, uint16_t u) {
-  uint16_t skip = A->cols - u;
-
-  for (int row = 0; row < i; row++) {
-    for (int col = 0; col < u; col++) {
-      uint8_t multiple = om_A(*A, row, col + skip);
+static void decode_phase4(struct solver *s) {
+  for (int row = 0; row < s->i; row++) {
+    for (int slot = 0; slot < s->u; slot++) {
+      uint8_t multiple = om_A(s->U, row, slot);
       if (multiple == 0)
         continue;
-      oaxpy(om_P(*D), om_P(*D), row, i + col, D->cols, multiple);
+      solver_d_axpy(s, row, s->prm->L - 1 - slot, multiple);
     }
   }
 }
 
-static void decode_phase5(octmat *A, octmat *D, uint16_t i) {
-  uint8_t multiple = 0;
-  for (int j = 0; j <= i; j++) {
-    if (om_A(*A, j, j) != 1) {
-      multiple = om_A(*A, j, j);
-      // oscal(om_P(*A), j, A->cols, OCTET_DIV(1, multiple));
-      oscal(om_P(*D), j, D->cols, OCTET_DIV(1, multiple));
-    }
-    for (int l = 0; l < j; l++) {
-      multiple = om_A(*A, j, l);
-      if (multiple == 0)
-        continue;
-      oaxpy(om_P(*A), om_P(*A), j, l, A->cols, multiple);
-      oaxpy(om_P(*D), om_P(*D), j, l, D->cols, multiple);
+/* forward substitution over the lower triangular upper left i x i of A */
+static void decode_phase5(struct solver *s) {
+  for (int j = 0; j < s->i; j++) {
+    uint16_t row = s->rid[j];
+    if (solver_is_hdpc(s, row)) {
+      for (int l = 0; l < j; l++) {
+        uint8_t x = solver_hdpc_at(s, row, l);
+        if (x != 0)
+          solver_d_axpy(s, j, l, x);
+      }
+    } else {
+      uint16_vec *idxs = &s->A->sp->idxs[row];
+      for (int idx = 0; idx < kv_size(*idxs); idx++) {
+        uint16_t l = s->cpos[kv_A(*idxs, idx)];
+        if (l < j)
+          solver_d_axpy(s, j, l, 1);
+      }
     }
+    uint8_t pivot = solver_pivot_value(s, j, j);
+    if (pivot != 1)
+      solver_d_scal(s, j, OCTET_DIV(1, pivot));
   }
 }
 
-void precode_matrix_gen(struct pparams *prm, octmat *A, uint16_t overhead) {
-  om_resize(A, prm->L + overhead, prm->L);
+void precode_matrix_gen(struct pparams *prm, struct cmat *A,
+                        uint16_t overhead) {
+  A->sp = spmat_new(prm->L + overhead, prm->L);
+  A->hdpc = (octmat)OM_INITIAL;
+  om_resize(&A->hdpc, prm->H, prm->L);
 
   precode_matrix_init_LDPC1(A, prm->S, prm->B);
   precode_matrix_add_identity(A, prm->S, 0, prm->B);
   precode_matrix_init_LDPC2(A, prm->W, prm->S, prm->P);
   precode_matrix_init_HDPC(prm, A);
-  precode_matrix_add_identity(A, prm->H, prm->S, prm->L - prm->H);
+  for (int diag = 0; diag < prm->H; diag++) {
+    om_A(A->hdpc, diag, prm->L - prm->H + diag) = 1;
+  }
   precode_matrix_add_G_ENC(prm, A);
 }
 
-octmat precode_matrix_intermediate1(struct pparams *prm, octmat *A, octmat *D) {
-  bool success;
-  uint16_t i, u;
-
-  uint16_vec c;
-  kv_init(c);
+void precode_matrix_free(struct cmat *A) {
+  spmat_free(A->sp);
+  A->sp = NULL;
+  om_destroy(&A->hdpc);
+}
 
+static octmat precode_matrix_permute(struct pparams *prm, octmat *D,
+                                     uint16_vec *c) {
   octmat C = OM_INITIAL;
-  octmat X = OM_INITIAL;
-
-  if (prm->L == 0 || A == NULL || A->rows == 0 || A->cols == 0) {
-    return C;
-  }
 
-  om_copy(&X, A);
-  kv_resize(uint16_t, c, prm->L);
+  om_resize(&C, D->rows, D->cols);
   for (int l = 0; l < prm->L; l++) {
-    kv_push(uint16_t, c, l);
+    ocopy(om_P(C), om_P(*D), kv_A(*c, l), l, C.cols);
   }
+  return C;
+}
 
-  success = decode_phase1(prm, A, &X, D, c, &i, &u);
-  if (!success) {
-    kv_destroy(c);
-    om_destroy(&X);
-    return C;
-  }
+/* symbolic pass: solves A and records the row operations for D in plan */
+bool precode_matrix_symbolic(struct pparams *prm, struct cmat *A,
+                             struct plan *plan) {
+  bool success;
+  struct solver s = {0};
 
-  success = decode_phase2(A, D, i, u, prm->L);
-  if (!success) {
-    kv_destroy(c);
-    om_destroy(&X);
-    return C;
+  if (prm->L == 0 || A == NULL || A->sp == NULL || A->sp->rows == 0) {
+    return false;
   }
 
-  decode_phase3(A, &X, D, i);
-  om_destroy(&X);
-  decode_phase4(A, D, i, u);
-  decode_phase5(A, D, i);
-  om_destroy(A);
-
-  om_resize(&C, D->rows, D->cols);
+  s.prm = prm;
+  s.A = A;
+  s.AT = spmat_transpose(A->sp);
+  s.plan = plan;
+  s.rows = A->sp->rows;
+  s.u = prm->P;
+  s.rid = calloc(s.rows, sizeof(uint16_t));
+  s.rpos = calloc(s.rows, sizeof(uint16_t));
+  s.flushed = calloc(s.rows, sizeof(uint16_t));
+  s.cpos = calloc(prm->L, sizeof(uint16_t));
+  s.mark = calloc(prm->L, sizeof(uint8_t));
+  for (int row = 0; row < s.rows; row++) {
+    s.rid[row] = s.rpos[row] = row;
+  }
+  kv_init(s.log);
+  kv_init(s.c);
+  kv_resize(uint16_t, s.c, prm->L);
   for (int l = 0; l < prm->L; l++) {
-    ocopy(om_P(C), om_P(*D), kv_A(c, l), l, C.cols);
+    kv_push(uint16_t, s.c, l);
+    s.cpos[l] = l;
+  }
+  s.U = (octmat)OM_INITIAL;
+  om_resize(&s.U, s.rows, 2 * prm->P);
+
+  success = decode_phase1(&s);
+  if (success)
+    success = decode_phase2(&s);
+
+  if (success) {
+    decode_phase3(&s);
+    decode_phase4(&s);
+    decode_phase5(&s);
+    kv_copy(uint16_t, plan->c, s.c);
   }
-  kv_destroy(c);
 
-  return C;
+  spmat_free(s.AT);
+  om_destroy(&s.U);
+  kv_destroy(s.c);
+  kv_destroy(s.log);
+  free(s.rid);
+  free(s.rpos);
+  free(s.flushed);
+  free(s.cpos);
+  free(s.mark);
+
+  return success;
 }
 
-bool precode_matrix_intermediate2(octmat *M, octmat *A, octmat *D,
-                                  struct pparams *prm, repair_vec *repair_bin,
-                                  struct bitmask *mask, uint16_t num_symbols,
-                                  uint16_t overhead) {
-
-  int num_gaps, gap = 0, row = 0;
-  octmat C;
-
-  if (D->cols == 0) {
-    return false;
-  }
-
-  decode_phase0(prm, A, mask, repair_bin, num_symbols, overhead);
+/* numeric pass: replays plan on D and returns the intermediate symbols */
+octmat precode_matrix_numeric(struct pparams *prm, struct plan *plan,
+                              octmat *D, struct pool *pool) {
+  plan_apply(plan, D, pool);
+  return precode_matrix_permute(prm, D, &plan->c);
+}
 
-  C = precode_matrix_intermediate1(prm, A, D);
-  if (C.rows == 0) {
-    return false;
-  }
+octmat precode_matrix_solve(struct pparams *prm, octmat *D,
+                            struct pool *pool) {
+  struct plan *plan = precode_matrix_plan(prm);
 
-  num_gaps = bitmask_gaps(mask, num_symbols);
-  om_resize(M, num_gaps, D->cols);
-  for (gap = 0; gap < num_symbols && num_gaps > 0; gap++) {
-    if (bitmask_check(mask, gap))
-      continue;
-    octmat ret = precode_matrix_encode(prm, &C, gap);
-    ocopy(om_P(*M), om_P(ret), row, 0, M->cols);
-    om_destroy(&ret);
-    row++;
-    num_gaps--;
-  }
-  om_destroy(&C);
-  return true;
+  if (plan == NULL)
+    return (octmat)OM_INITIAL;
+  return precode_matrix_numeric(prm, plan, D, pool);
 }
 
-octmat precode_matrix_encode(struct pparams *prm, octmat *C, uint32_t isi) {
-  octmat ret = OM_INITIAL;
-  om_resize(&ret, 1, C->cols);
+struct plan *precode_matrix_plan(struct pparams *prm) {
+  struct plan *plan = plan_cache_claim(prm->K_padded, prm->L);
+  struct cmat A = {0};
 
-  uint16_vec idxs = params_get_idxs(prm, isi);
-  for (int idx = 0; idx < kv_size(idxs); idx++) {
-    oaddrow(om_P(ret), om_P(*C), 0, kv_A(idxs, idx), ret.cols);
-  }
-  kv_destroy(idxs);
+  if (!plan->pending)
+    return plan;
 
-  return ret;
+  precode_matrix_gen(prm, &A, 0);
+  bool success = precode_matrix_symbolic(prm, &A, plan);
+  precode_matrix_free(&A);
+
+  return plan_cache_publish(plan, success);
 }
 
-bool precode_matrix_decode(struct pparams *prm, octmat *X,
-                           repair_vec *repair_bin, struct bitmask *mask) {
-  uint16_t num_symbols = X->rows, rep_idx, num_gaps, num_repair, overhead;
+static const struct params_idxs *precode_tuple(struct pparams *prm,
+                                               struct params_cache *cache,
+                                               uint32_t isi,
+                                               struct params_idxs *local) {
+  if (cache)
+    return params_cache_get(cache, prm, isi);
+  *local = params_get_idxs(prm, isi);
+  return local;
+}
 
-  octmat A = OM_INITIAL;
-  octmat D = OM_INITIAL;
-  octmat M = OM_INITIAL;
+/* writes the symbol isi into out, C->cols bytes. cache may be NULL */
+void precode_matrix_encode(struct pparams *prm, struct params_cache *cache,
+                           octmat *C, uint32_t isi, uint8_t *out) {
+  struct params_idxs local;
+  const struct params_idxs *t = precode_tuple(prm, cache, isi, &local);
 
-  num_repair = kv_size(*repair_bin);
-  num_gaps = bitmask_gaps(mask, num_symbols);
+  memset(out, 0, C->cols);
+  for (int idx = 0; idx < t->len; idx++) {
+    gf256_addrow(out, om_R(*C, t->idx[idx]), C->cols);
+  }
+}
 
-  if (num_gaps == 0)
-    return true;
+/*
+ * writes the count symbols from esi on into out, stride bytes apart. the
+ * outputs are built a chunk at a time by walking C once, each row of C is
+ * added to every output of the chunk that uses it before moving on.
+ */
+void precode_matrix_encode_batch(struct pparams *prm,
+                                 struct params_cache *cache, octmat *C,
+                                 uint16_t num_symbols, uint32_t esi,
+                                 uint32_t count, uint8_t *out, size_t stride) {
+  uint32_t padding = prm->K_padded - num_symbols;
+  uint32_t chunk = ENCODE_CHUNK_BYTES / (C->cols ? C->cols : 1);
+  struct params_idxs local;
+
+  if (C->cols <= ENCODE_DIRECT_BYTES) {
+    for (uint32_t j = 0; j < count; j++) {
+      uint32_t isi = esi + j;
+      isi += (isi < num_symbols) ? 0 : padding;
+      precode_matrix_encode(prm, cache, C, isi, out + (size_t)j * stride);
+    }
+    return;
+  }
 
-  if (num_repair < num_gaps)
-    return false;
+  /* with under L outputs most rows of C read would serve a single one */
+  if (chunk < prm->L)
+    chunk = prm->L;
+  if (chunk > count)
+    chunk = count;
+
+  /* users[first[r - 1] .. first[r]) are the outputs row r is added to */
+  uint32_t *first = calloc(prm->L + 1, sizeof(uint32_t));
+  uint32_t *users = calloc((size_t)chunk * PARAMS_MAX_IDXS, sizeof(uint32_t));
+
+  for (uint32_t base = 0; base < count; base += chunk) {
+    uint32_t n = (count - base < chunk) ? count - base : chunk;
+
+    memset(first, 0, (prm->L + 1) * sizeof(uint32_t));
+    for (uint32_t j = 0; j < n; j++) {
+      uint32_t isi = esi + base + j;
+      isi += (isi < num_symbols) ? 0 : padding;
+      const struct params_idxs *t = precode_tuple(prm, cache, isi, &local);
+      for (int idx = 0; idx < t->len; idx++) {
+        first[t->idx[idx] + 1]++;
+      }
+      memset(out + (size_t)(base + j) * stride, 0, C->cols);
+    }
+    for (int row = 0; row < prm->L; row++) {
+      first[row + 1] += first[row];
+    }
+    for (uint32_t j = 0; j < n; j++) {
+      uint32_t isi = esi + base + j;
+      isi += (isi < num_symbols) ? 0 : padding;
+      const struct params_idxs *t = precode_tuple(prm, cache, isi, &local);
+      for (int idx = 0; idx < t->len; idx++) {
+        users[first[t->idx[idx]]++] = j;
+      }
+    }
 
-  overhead = num_repair - num_gaps;
-  rep_idx = 0;
-  precode_matrix_gen(prm, &A, overhead);
+    /* first[r] now ends the users of row r */
+    uint32_t user = 0;
+    for (int row = 0; row < prm->L; row++) {
+      for (; user < first[row]; user++) {
+        uint8_t *dst = out + (size_t)(base + users[user]) * stride;
+        gf256_addrow(dst, om_R(*C, row), C->cols);
+      }
+    }
+  }
+  free(first);
+  free(users);
+}
 
-  om_resize(&D, prm->S + prm->H + prm->K_padded + overhead, X->cols);
+/*
+ * rebuild columns [col, col + C->cols) of the source symbols missing from X
+ * out of intermediate symbols C, in place. the gaps are marked as filled
+ * once their last columns are in.
+ */
+void precode_matrix_fill_gaps(struct pparams *prm, octmat *C, octmat *X,
+                              struct bitmask *mask, uint16_t col) {
+  for (int row = 0; row < X->rows; row++) {
+    if (!bitmask_check(mask, row))
+      precode_matrix_encode(prm, NULL, C, row, om_R(*X, row) + col);
+  }
+  if (col + C->cols == X->cols) {
+    for (int row = 0; row < X->rows; row++) {
+      bitmask_set(mask, row);
+    }
+  }
+}
 
+/* D for columns [col, col + cols) of the received symbols, laid out to match
+ * the rows decode_phase0 put in A */
+static octmat precode_matrix_load(struct pparams *prm, octmat *X,
+                                  repair_vec *repair_bin, struct bitmask *mask,
+                                  uint16_t overhead, uint16_t col,
+                                  uint16_t cols) {
+  uint16_t num_repair = kv_size(*repair_bin), rep_idx = 0;
   int skip = prm->S + prm->H;
+  octmat D = OM_INITIAL;
+
+  om_resize(&D, skip + prm->K_padded + overhead, cols);
   for (int row = 0; row < X->rows; row++) {
-    ocopy(om_P(D), om_P(*X), skip + row, row, D.cols);
+    memcpy(om_R(D, skip + row), om_R(*X, row) + col, cols);
   }
 
-  for (int gap = 0; gap < num_symbols && rep_idx < num_repair; gap++) {
+  for (int gap = 0; gap < X->rows && rep_idx < num_repair; gap++) {
     if (bitmask_check(mask, gap))
       continue;
-    uint16_t row = skip + gap;
-    struct repair_sym rs = kv_A(*repair_bin, rep_idx++);
-    ocopy(om_P(D), om_P(rs.row), row, 0, D.cols);
+    struct repair_sym *rs = &kv_A(*repair_bin, rep_idx++);
+    memcpy(om_R(D, skip + gap), om_R(rs->row, 0) + col, cols);
   }
 
   for (int row = skip + prm->K_padded; rep_idx < num_repair; row++) {
-    struct repair_sym rs = kv_A(*repair_bin, rep_idx++);
-    ocopy(om_P(D), om_P(rs.row), row, 0, D.cols);
+    struct repair_sym *rs = &kv_A(*repair_bin, rep_idx++);
+    memcpy(om_R(D, row), om_R(rs->row, 0) + col, cols);
   }
+  return D;
+}
 
-  bool precode_ok = precode_matrix_intermediate2(&M, &A, &D, prm, repair_bin,
-                                                 mask, num_symbols, overhead);
-  om_destroy(&A);
-  om_destroy(&D);
+/*
+ * A is solved once for the received symbols, the plan is then replayed on
+ * one sub-block of columns at a time so only a sub-block wide D is live.
+ * subs holds the sub-block widths in bytes, NULL solves all of X at once.
+ */
+bool precode_matrix_decode(struct pparams *prm, octmat *X,
+                           repair_vec *repair_bin, struct bitmask *mask,
+                           struct pool *pool, uint16_vec *subs) {
+  uint16_t num_symbols = X->rows, num_gaps, num_repair, overhead;
+  struct cmat A = {0};
 
-  if (!precode_ok)
-    return false;
+  num_repair = kv_size(*repair_bin);
+  num_gaps = bitmask_gaps(mask, num_symbols);
 
-  int miss_row = 0;
-  for (int row = 0; row < num_symbols && miss_row < M.rows; row++) {
-    if (bitmask_check(mask, row))
-      continue;
-    miss_row++;
-    if (bitmask_check(mask, row))
-      continue;
+  if (num_gaps == 0)
+    return true;
 
-    ocopy(om_P(*X), om_P(M), row, miss_row - 1, X->cols);
-    bitmask_set(mask, row);
+  if (num_repair < num_gaps || X->cols == 0)
+    return false;
+
+  overhead = num_repair - num_gaps;
+  precode_matrix_gen(prm, &A, overhead);
+  decode_phase0(prm, &A, mask, repair_bin, num_symbols, overhead);
+
+  struct plan *plan = plan_new(prm->K_padded, A.sp->rows);
+  bool success = precode_matrix_symbolic(prm, &A, plan);
+  precode_matrix_free(&A);
+
+  int num_subs = subs ? kv_size(*subs) : 1;
+  uint16_t col = 0;
+  for (int sub = 0; sub < num_subs && success; sub++) {
+    uint16_t cols = subs ? kv_A(*subs, sub) : X->cols;
+    octmat D = precode_matrix_load(prm, X, repair_bin, mask, overhead, col,
+                                   cols);
+    octmat C = precode_matrix_numeric(prm, plan, &D, pool);
+    om_destroy(&D);
+
+    precode_matrix_fill_gaps(prm, &C, X, mask, col);
+    om_destroy(&C);
+    col += cols;
   }
-  om_destroy(&M);
-  return true;
+  plan_free(plan);
+
+  return success;
 }
@@ -3,18 +3,40 @@
 
 #include "bitmask.h"
 #include "params.h"
+#include "plan.h"
+#include "spmat.h"
 
-void precode_matrix_gen(struct pparams *prm, octmat *A, uint16_t overhead);
+/* constraint matrix A: LDPC, LT and repair rows are binary and kept sparse,
+ * only the H HDPC rows are stored dense */
+struct cmat {
+  struct spmat *sp;
+  octmat hdpc;
+};
 
-octmat precode_matrix_intermediate1(struct pparams *prm, octmat *A, octmat *D);
-bool precode_matrix_intermediate2(octmat *M, octmat *A, octmat *D,
-                                  struct pparams *prm, repair_vec *repair_bin,
-                                  struct bitmask *mask, uint16_t num_symbols,
-                                  uint16_t overhead);
+void precode_matrix_gen(struct pparams *prm, struct cmat *A, uint16_t overhead);
+void precode_matrix_free(struct cmat *A);
 
-octmat precode_matrix_encode(struct pparams *prm, octmat *C, uint32_t isi);
+bool precode_matrix_symbolic(struct pparams *prm, struct cmat *A,
+                             struct plan *plan);
+octmat precode_matrix_numeric(struct pparams *prm, struct plan *plan,
+                              octmat *D, struct pool *pool);
+
+octmat precode_matrix_solve(struct pparams *prm, octmat *D,
+                            struct pool *pool);
+struct plan *precode_matrix_plan(struct pparams *prm);
+
+void precode_matrix_encode(struct pparams *prm, struct params_cache *cache,
+                           octmat *C, uint32_t isi, uint8_t *out);
+void precode_matrix_encode_batch(struct pparams *prm,
+                                 struct params_cache *cache, octmat *C,
+                                 uint16_t num_symbols, uint32_t esi,
+                                 uint32_t count, uint8_t *out, size_t stride);
+
+void precode_matrix_fill_gaps(struct pparams *prm, octmat *C, octmat *X,
+                              struct bitmask *mask, uint16_t col);
 
 bool precode_matrix_decode(struct pparams *prm, octmat *X,
-                           repair_vec *repair_bin, struct bitmask *mask);
+                           repair_vec *repair_bin, struct bitmask *mask,
+                           struct pool *pool, uint16_vec *subs);
 
 #endif
@@ -0,0 +1,54 @@
+#include <stdlib.h>
+
+#include "spmat.h"
+
+struct spmat *spmat_new(uint16_t rows, uint16_t cols) {
+  struct spmat *m = calloc(1, sizeof(struct spmat));
+
+  m->rows = rows;
+  m->cols = cols;
+  m->idxs = calloc(rows, sizeof(uint16_vec));
+
+  return m;
+}
+
+bool spmat_check(struct spmat *m, uint16_t row, uint16_t col) {
+  uint16_vec *r = &m->idxs[row];
+  for (size_t idx = 0; idx < kv_size(*r); idx++) {
+    if (kv_A(*r, idx) == col)
+      return true;
+  }
+  return false;
+}
+
+void spmat_set(struct spmat *m, uint16_t row, uint16_t col) {
+  if (spmat_check(m, row, col))
+    return;
+  kv_push(uint16_t, m->idxs[row], col);
+}
+
+void spmat_clear_row(struct spmat *m, uint16_t row) {
+  kv_size(m->idxs[row]) = 0;
+}
+
+struct spmat *spmat_transpose(struct spmat *m) {
+  struct spmat *t = spmat_new(m->cols, m->rows);
+
+  for (int row = 0; row < m->rows; row++) {
+    uint16_vec *r = &m->idxs[row];
+    for (size_t idx = 0; idx < kv_size(*r); idx++) {
+      kv_push(uint16_t, t->idxs[kv_A(*r, idx)], row);
+    }
+  }
+  return t;
+}
+
+void spmat_free(struct spmat *m) {
+  if (m) {
+    for (int row = 0; row < m->rows; row++) {
+      kv_destroy(m->idxs[row]);
+    }
+    free(m->idxs);
+    free(m);
+  }
+}
@@ -0,0 +1,23 @@
+#ifndef NANORQ_SPMAT_H
+#define NANORQ_SPMAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util.h"
+
+/* binary sparse matrix, each row holds the column indices of its ones */
+struct spmat {
+  uint16_t rows;
+  uint16_t cols;
+  uint16_vec *idxs;
+};
+
+struct spmat *spmat_new(uint16_t rows, uint16_t cols);
+void spmat_set(struct spmat *m, uint16_t row, uint16_t col);
+bool spmat_check(struct spmat *m, uint16_t row, uint16_t col);
+void spmat_clear_row(struct spmat *m, uint16_t row);
+struct spmat *spmat_transpose(struct spmat *m);
+void spmat_free(struct spmat *m);
+
+#endif
@@ -0,0 +1,45 @@
+#include "test.h"
+
+/* encodes count symbols of every block from first on in one batch, stride
+ * bytes apart, and checks them against nanorq_encode one at a time */
+static void run(size_t len, uint16_t T, uint16_t Z, uint32_t first,
+                uint32_t count, size_t stride, uint32_t tuple_cache) {
+  uint8_t *in = random_buf(len);
+  uint8_t *out = malloc(count * stride), sym[T];
+  struct ioctx *io = ioctx_from_mem(in, len);
+  nanorq *rq = nanorq_encoder_new_ex(len, T, 0, Z, 8);
+
+  CHECK(rq != NULL);
+  nanorq_set_tuple_cache(rq, tuple_cache);
+  CHECK(nanorq_encode_batch(rq, 0, first, count, out, T - 1, io) == 0);
+  for (int sbn = 0; sbn < nanorq_blocks(rq); sbn++) {
+    /* the block is generated on demand */
+    memset(out, 0xa5, count * stride);
+    CHECK(nanorq_encode_batch(rq, sbn, first, count, out, stride, io) ==
+          count);
+    for (uint32_t i = 0; i < count; i++) {
+      uint8_t *got = out + i * stride;
+      CHECK(nanorq_encode(rq, sym, first + i, sbn, io) == T);
+      CHECK(memcmp(sym, got, T) == 0);
+      /* the gap between symbols is left alone */
+      for (size_t pos = T; pos < stride; pos++)
+        CHECK(got[pos] == 0xa5);
+    }
+  }
+
+  nanorq_free(rq);
+  io->destroy(io);
+  free(in);
+  free(out);
+}
+
+int main(int argc, char *argv[]) {
+  run(64 * 1000, 64, 1, 1000, 500, 64, 0);
+  run(64 * 1000, 64, 1, 0, 1500, 80, 13);
+  run(16 * 3000, 16, 2, 1400, 2000, 24, 0);
+  run(4096 * 200, 4096, 1, 150, 300, 4100, 0);
+  run(256 * 200, 256, 1, 100, 3000, 300, 11);
+
+  printf("batch ok\n");
+  return 0;
+}
@@ -0,0 +1,97 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "test.h"
+
+#define CATALOG "test_catalog.bin"
+#define CORRUPT "test_catalog_bad.bin"
+
+static const uint16_t sizes[] = {10, 101, 1000};
+
+/* repair symbols of a block of K symbols, solved with whatever plans are
+ * cached */
+static void repair(uint16_t K, uint8_t *in, uint8_t *out, int count) {
+  uint16_t T = 64;
+  struct ioctx *io = ioctx_from_mem(in, (size_t)K * T);
+  nanorq *rq = nanorq_encoder_new_ex((size_t)K * T, T, K, 0, 8);
+
+  CHECK(rq != NULL && nanorq_generate_symbols(rq, 0, io));
+  uint32_t first = nanorq_block_symbols(rq, 0);
+  for (int i = 0; i < count; i++) {
+    CHECK(nanorq_encode(rq, out + i * T, first + i, 0, io) == T);
+  }
+  nanorq_free(rq);
+  io->destroy(io);
+}
+
+/* copies the catalog with len bytes at offset replaced by val */
+static void corrupt(size_t offset, const void *val, size_t len) {
+  FILE *in = fopen(CATALOG, "rb");
+  FILE *out = fopen(CORRUPT, "wb");
+  int ch;
+  CHECK(in && out);
+  for (size_t pos = 0; (ch = fgetc(in)) != EOF; pos++) {
+    if (pos >= offset && pos < offset + len)
+      ch = ((const uint8_t *)val)[pos - offset];
+    fputc(ch, out);
+  }
+  fclose(in);
+  fclose(out);
+}
+
+int main(int argc, char *argv[]) {
+  int num = sizeof(sizes) / sizeof(sizes[0]);
+  uint8_t *in = random_buf(1000 * 64);
+  uint8_t want[num][20 * 64], got[num][20 * 64];
+
+  for (int i = 0; i < num; i++) {
+    repair(sizes[i], in, want[i], 20);
+  }
+  CHECK(!nanorq_plan_catalog_write(CATALOG, sizes, 0));
+  CHECK(nanorq_plan_catalog_write(CATALOG, sizes, num));
+
+  /* symbols from the loaded plans match the ones from solving */
+  nanorq_plan_cache_clear();
+  CHECK(nanorq_plan_catalog_load(CATALOG));
+  for (int i = 0; i < num; i++) {
+    repair(sizes[i], in, got[i], 20);
+    CHECK(memcmp(want[i], got[i], sizeof(got[i])) == 0);
+  }
+  nanorq_plan_cache_clear();
+
+  /* header: magic, version, count. then per entry K', rows, ops, offset */
+  size_t entry = 8;
+  uint16_t bad_k = 11, bad_rows = 1;
+  uint64_t bad_offset = 12, huge_offset = ~0ULL - 4;
+  uint16_t bad_row = 0xffff;
+
+  corrupt(entry, &bad_k, sizeof(bad_k));
+  CHECK(!nanorq_plan_catalog_load(CORRUPT));
+  corrupt(entry + 2, &bad_rows, sizeof(bad_rows));
+  CHECK(!nanorq_plan_catalog_load(CORRUPT));
+  corrupt(entry + 8, &bad_offset, sizeof(bad_offset));
+  CHECK(!nanorq_plan_catalog_load(CORRUPT));
+  corrupt(entry + 8, &huge_offset, sizeof(huge_offset));
+  CHECK(!nanorq_plan_catalog_load(CORRUPT));
+
+  /* the dst of the first op of the first plan */
+  uint64_t data;
+  FILE *fp = fopen(CATALOG, "rb");
+  CHECK(fp && fseek(fp, entry + 8, SEEK_SET) == 0);
+  CHECK(fread(&data, sizeof(data), 1, fp) == 1);
+  fclose(fp);
+  corrupt(data + 2, &bad_row, sizeof(bad_row));
+  CHECK(!nanorq_plan_catalog_load(CORRUPT));
+
+  /* a rejected file leaves nothing behind, the good one still loads */
+  CHECK(nanorq_plan_catalog_load(CATALOG));
+  repair(sizes[0], in, got[0], 20);
+  CHECK(memcmp(want[0], got[0], sizeof(got[0])) == 0);
+
+  nanorq_plan_cache_clear();
+  unlink(CATALOG);
+  unlink(CORRUPT);
+  free(in);
+  printf("catalog ok\n");
+  return 0;
+}
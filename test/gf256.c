@@ -0,0 +1,74 @@
+#include <octmat.h>
+
+#include "gf256.h"
+#include "test.h"
+
+#define GUARD 64
+
+static const char *kernels[] = {"generic", "ssse3",  "avx2",
+                                "gfni",    "avx512", "gfni-avx512"};
+/* around every vector width, so the wide loops and the tails both run */
+static const size_t lens[] = {0,  1,  7,   15,  16,  17,  31,  32,   33,
+                              63, 64, 65,  127, 128, 129, 255, 257, 1031};
+
+/* runs the kernel in use over len bytes at offset into a, with all u, and
+ * checks every byte against OCTET_MUL and the bytes around it untouched */
+static void check(const uint8_t *a, const uint8_t *b, size_t len,
+                  size_t offset) {
+  size_t size = GUARD + len + GUARD;
+  uint8_t *got = malloc(size), *want = malloc(size);
+
+  for (int u = 0; u < 256; u++) {
+    memcpy(got, a, size);
+    memcpy(want, a, size);
+    gf256_axpy(got + GUARD + offset, b, len, u);
+    for (size_t i = 0; i < len; i++)
+      want[GUARD + offset + i] ^= OCTET_MUL(u, b[i]);
+    CHECK(memcmp(got, want, size) == 0);
+
+    memcpy(got, a, size);
+    memcpy(want, a, size);
+    gf256_scal(got + GUARD + offset, len, u);
+    for (size_t i = 0; i < len; i++)
+      want[GUARD + offset + i] = OCTET_MUL(u, a[GUARD + offset + i]);
+    CHECK(memcmp(got, want, size) == 0);
+  }
+
+  memcpy(got, a, size);
+  memcpy(want, a, size);
+  gf256_addrow(got + GUARD + offset, b, len);
+  for (size_t i = 0; i < len; i++)
+    want[GUARD + offset + i] ^= b[i];
+  CHECK(memcmp(got, want, size) == 0);
+
+  free(got);
+  free(want);
+}
+
+int main(int argc, char *argv[]) {
+  const char *chosen = gf256_kernel();
+  size_t max = lens[sizeof(lens) / sizeof(lens[0]) - 1] + 3;
+  uint8_t *a = random_buf(GUARD + max + GUARD), *b = random_buf(max);
+  int used = 0;
+
+  for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+    if (!gf256_kernel_use(kernels[k]))
+      continue;
+    CHECK(strcmp(gf256_kernel(), kernels[k]) == 0);
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+      /* unaligned rows */
+      for (size_t offset = 0; offset < 4; offset++)
+        check(a, b + (3 - offset), lens[l], offset);
+    }
+    printf("gf256 %s ok\n", kernels[k]);
+    used++;
+  }
+  CHECK(used > 0);
+  CHECK(!gf256_kernel_use("none"));
+  CHECK(gf256_kernel_use(chosen));
+
+  free(a);
+  free(b);
+  printf("gf256 ok\n");
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include "test.h"
+
+/* decodes the same symbols with the batch and the incremental decoder */
+static void run(size_t len, uint16_t T, int loss) {
+  uint8_t *in = random_buf(len);
+  uint8_t *out_batch = calloc(1, len), *out_inc = calloc(1, len);
+  struct ioctx *io = ioctx_from_mem(in, len);
+  nanorq *enc = nanorq_encoder_new_ex(len, T, 0, 3, 8);
+  CHECK(enc != NULL);
+
+  uint64_t common = nanorq_oti_common(enc);
+  uint32_t scheme = nanorq_oti_scheme_specific(enc);
+  nanorq *batch = nanorq_decoder_new(common, scheme);
+  nanorq *inc = nanorq_decoder_new_ex(common, scheme, true);
+  CHECK(batch != NULL && inc != NULL);
+
+  uint8_t sym[T];
+  for (int sbn = 0; sbn < nanorq_blocks(enc); sbn++) {
+    uint32_t K = nanorq_block_symbols(enc, sbn), dropped = 0;
+    uint32_t added = 0, ready_at = 0;
+    for (uint32_t esi = 0; esi < K + dropped + 2; esi++) {
+      if (esi < K && rand() % 100 < loss) {
+        dropped++;
+        continue;
+      }
+      CHECK(nanorq_encode(enc, sym, esi, sbn, io) == T);
+      CHECK(nanorq_decoder_add_symbol(batch, sym, nanorq_fid(sbn, esi)));
+      CHECK(nanorq_decoder_add_symbol(inc, sym, nanorq_fid(sbn, esi)));
+      added++;
+      if (ready_at == 0 && nanorq_decoder_ready(inc, sbn))
+        ready_at = added;
+    }
+    CHECK(nanorq_num_missing(batch, sbn) == nanorq_num_missing(inc, sbn));
+    CHECK(nanorq_num_repair(batch, sbn) == nanorq_num_repair(inc, sbn));
+
+    /* the incremental decoder solved the block as the symbols came in, at
+     * least K of them, while the batch one has all its work ahead */
+    CHECK(ready_at >= K && ready_at <= added);
+    CHECK(nanorq_decoder_ready(batch, sbn) == (dropped == 0));
+  }
+
+  struct ioctx *bio = ioctx_from_mem(out_batch, len);
+  struct ioctx *iio = ioctx_from_mem(out_inc, len);
+  for (int sbn = 0; sbn < nanorq_blocks(enc); sbn++) {
+    uint64_t a = nanorq_decode_block(batch, bio, sbn);
+    uint64_t b = nanorq_decode_block(inc, iio, sbn);
+    CHECK(a > 0 && a == b);
+  }
+  CHECK(memcmp(in, out_batch, len) == 0);
+  CHECK(memcmp(in, out_inc, len) == 0);
+
+  nanorq_free(enc);
+  nanorq_free(batch);
+  nanorq_free(inc);
+  io->destroy(io);
+  bio->destroy(bio);
+  iio->destroy(iio);
+  free(in);
+  free(out_batch);
+  free(out_inc);
+}
+
+int main(int argc, char *argv[]) {
+  run(64 * 1000, 64, 0);
+  run(64 * 1000 + 13, 64, 10);
+  run(256 * 2000, 256, 50);
+  printf("incremental ok\n");
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include "test.h"
+
+/* checks every source symbol's iov against nanorq_encode, returns how many
+ * came through pad rather than in place */
+static int check_block(nanorq *rq, uint8_t sbn, struct ioctx *io,
+                       const uint8_t *in, size_t len, int iovcnt) {
+  uint16_t T = nanorq_symbol_size(rq);
+  uint8_t want[T], got[T], pad[T];
+  struct iovec iov[iovcnt];
+  int padded = 0;
+
+  for (uint32_t esi = 0; esi < nanorq_block_symbols(rq, sbn); esi++) {
+    int cnt = nanorq_source_iov(rq, sbn, esi, io, iov, iovcnt, pad);
+    size_t at = 0;
+
+    CHECK(cnt > 0);
+    CHECK(nanorq_encode(rq, want, esi, sbn, io) == T);
+    for (int i = 0; i < cnt; i++) {
+      CHECK(at + iov[i].iov_len <= T);
+      memcpy(got + at, iov[i].iov_base, iov[i].iov_len);
+      at += iov[i].iov_len;
+    }
+    CHECK(at == T);
+    CHECK(memcmp(want, got, T) == 0);
+
+    if (iov[0].iov_base == pad) {
+      CHECK(cnt == 1);
+      padded++;
+    } else {
+      for (int i = 0; i < cnt; i++) {
+        const uint8_t *base = iov[i].iov_base;
+        CHECK(base >= in && base + iov[i].iov_len <= in + len);
+      }
+    }
+  }
+  return padded;
+}
+
+/* source symbols of a len byte input are mapped in place except the short
+ * final one, which is padded with zeros */
+static void run(nanorq *rq, uint8_t *in, size_t len, int iovcnt,
+                int want_padded) {
+  struct ioctx *io = ioctx_from_mem(in, len);
+  int padded = 0;
+
+  CHECK(rq != NULL);
+  for (int sbn = 0; sbn < nanorq_blocks(rq); sbn++)
+    padded += check_block(rq, sbn, io, in, len, iovcnt);
+  CHECK(padded == want_padded);
+
+  /* repair esis have no source iov */
+  uint8_t pad[nanorq_symbol_size(rq)];
+  struct iovec iov[1];
+  CHECK(nanorq_source_iov(rq, 0, nanorq_block_symbols(rq, 0), io, iov, 1,
+                          pad) == 0);
+
+  nanorq_free(rq);
+  io->destroy(io);
+}
+
+int main(int argc, char *argv[]) {
+  size_t len = 1024 * 2000;
+  uint8_t *in = random_buf(len);
+
+  /* whole symbols map in place */
+  run(nanorq_encoder_new_ex(len, 1024, 0, 3, 8), in, len, 1, 0);
+  /* the short final symbol, in one and in several sub-blocks */
+  run(nanorq_encoder_new_ex(len - 100, 1024, 0, 3, 8), in, len - 100, 1, 1);
+  run(nanorq_encoder_new_ws(len - 100, 1024, 8, 256 * 1024, 8), in,
+      len - 100, 16, 1);
+  run(nanorq_encoder_new_ex(1000, 1024, 0, 1, 8), in, 1000, 1, 1);
+  /* too few entries for the sub-blocks falls back to pad */
+  nanorq *rq = nanorq_encoder_new_ws(len, 1024, 8, 256 * 1024, 8);
+  run(rq, in, len, 1, nanorq_block_symbols(rq, 0));
+
+  /* io short of the transfer fails rather than padding with zeros */
+  struct ioctx *io = ioctx_from_mem(in, len - 5000);
+  uint8_t pad[1024];
+  struct iovec iov[1];
+  rq = nanorq_encoder_new_ex(len, 1024, 0, 3, 8);
+  uint8_t last = nanorq_blocks(rq) - 1;
+  uint32_t esi = nanorq_block_symbols(rq, last) - 1;
+  CHECK(nanorq_source_iov(rq, last, esi, io, iov, 1, pad) == 0);
+  CHECK(nanorq_encode(rq, pad, esi, last, io) == 0);
+  CHECK(!nanorq_generate_symbols(rq, last, io));
+  CHECK(nanorq_generate_symbols(rq, 0, io));
+  nanorq_free(rq);
+  io->destroy(io);
+
+  free(in);
+  printf("iov ok\n");
+  return 0;
+}
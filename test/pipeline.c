@@ -0,0 +1,80 @@
+#include "test.h"
+
+struct emitted {
+  nanorq *ref; /* encodes the same input block by block */
+  struct ioctx *io;
+  int next;    /* sbn expected next */
+  int stop_at; /* sbn whose emit stops the pipeline, -1 for none */
+};
+
+/* checks the symbols of each block against an encoder that solves it on
+ * its own */
+static bool emit(nanorq *rq, uint8_t sbn, void *arg) {
+  struct emitted *e = arg;
+  uint16_t T = nanorq_symbol_size(rq);
+  uint8_t got[T], want[T];
+
+  CHECK(sbn == e->next);
+  e->next++;
+  for (uint32_t esi = 0; esi < nanorq_block_symbols(rq, sbn) + 20; esi++) {
+    CHECK(nanorq_encode(rq, got, esi, sbn, e->io) == T);
+    CHECK(nanorq_encode(e->ref, want, esi, sbn, e->io) == T);
+    CHECK(memcmp(got, want, T) == 0);
+  }
+  nanorq_encode_cleanup(e->ref, sbn);
+  return sbn != e->stop_at;
+}
+
+static void run(uint8_t *in, size_t len, bool positional, int depth,
+                int stop_at) {
+  struct ioctx *io = ioctx_from_mem(in, len);
+  nanorq *rq = nanorq_encoder_new_ex(len, 512, 0, 9, 8);
+  struct emitted e = {.ref = nanorq_encoder_new_ex(len, 512, 0, 9, 8),
+                      .io = io,
+                      .stop_at = stop_at};
+
+  CHECK(rq != NULL && e.ref != NULL);
+  if (!positional)
+    io->read_at = NULL;
+
+  bool ok = nanorq_encode_pipeline(rq, io, depth, emit, &e);
+  if (stop_at < 0) {
+    CHECK(ok);
+    CHECK(e.next == nanorq_blocks(rq));
+  } else {
+    /* nothing is emitted after the block that stopped it */
+    CHECK(!ok);
+    CHECK(e.next == stop_at + 1);
+  }
+
+  /* blocks solved ahead of a stop were let go, encoding picks up again */
+  uint8_t got[512], want[512];
+  for (int sbn = 0; sbn < nanorq_blocks(rq); sbn++) {
+    uint32_t esi = nanorq_block_symbols(rq, sbn);
+    CHECK(nanorq_encode(rq, got, esi, sbn, io) == 512);
+    CHECK(nanorq_encode(e.ref, want, esi, sbn, io) == 512);
+    CHECK(memcmp(got, want, 512) == 0);
+  }
+
+  nanorq_free(rq);
+  nanorq_free(e.ref);
+  io->destroy(io);
+}
+
+int main(int argc, char *argv[]) {
+  size_t len = 9 * 100 * 1000 + 77;
+  uint8_t *in = random_buf(len);
+
+  for (int depth = 1; depth <= 4; depth++) {
+    run(in, len, true, depth, -1);
+    run(in, len, true, depth, 0);
+    run(in, len, true, depth, 4);
+  }
+  /* without read_at the stages take turns */
+  run(in, len, false, 3, -1);
+  run(in, len, false, 3, 2);
+
+  free(in);
+  printf("pipeline ok\n");
+  return 0;
+}
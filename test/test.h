@@ -0,0 +1,27 @@
+#ifndef NANORQ_TEST_H
+#define NANORQ_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nanorq.h>
+
+/* regression tests, each binary exits non zero on the first failed check */
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
+
+static inline uint8_t *random_buf(size_t len) {
+  uint8_t *buf = malloc(len ? len : 1);
+  for (size_t i = 0; i < len; i++) {
+    buf[i] = rand();
+  }
+  return buf;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include <unistd.h>
+
+#include "test.h"
+
+#define INPUT "test_uring_in.bin"
+#define OUTPUT "test_uring_out.bin"
+
+/* a decoder with every source symbol of enc */
+static nanorq *received(nanorq *enc, struct ioctx *io) {
+  uint16_t T = nanorq_symbol_size(enc);
+  nanorq *dec = nanorq_decoder_new(nanorq_oti_common(enc),
+                                   nanorq_oti_scheme_specific(enc));
+  uint8_t sym[T];
+
+  CHECK(dec != NULL);
+  for (int sbn = 0; sbn < nanorq_blocks(enc); sbn++) {
+    for (uint32_t esi = 0; esi < nanorq_block_symbols(enc, sbn); esi++) {
+      CHECK(nanorq_encode(enc, sym, esi, sbn, io) == T);
+      CHECK(nanorq_decoder_add_symbol(dec, sym, nanorq_fid(sbn, esi)));
+    }
+  }
+  return dec;
+}
+
+int main(int argc, char *argv[]) {
+  size_t len = 3000017;
+  uint8_t *in = random_buf(len), *out = malloc(len);
+  FILE *fp = fopen(INPUT, "wb");
+  CHECK(fp && fwrite(in, 1, len, fp) == len);
+  fclose(fp);
+
+  struct ioctx *io = ioctx_from_uring(INPUT, 1);
+  nanorq *enc = nanorq_encoder_new_ex(len, 1024, 0, 7, 8);
+  CHECK(io != NULL && enc != NULL);
+  CHECK(nanorq_generate_all(enc, io, 4));
+  nanorq *dec = received(enc, io);
+
+  /* written in the background, all of it is there once decode returns */
+  struct ioctx *oio = ioctx_from_uring(OUTPUT, 0);
+  CHECK(oio != NULL);
+  CHECK(nanorq_decode_all(dec, oio, 4) == len);
+  CHECK(oio->size(oio) == len);
+  CHECK(oio->read_at(oio, out, len, 0) == len);
+  CHECK(memcmp(in, out, len) == 0);
+  CHECK(oio->flush == NULL || oio->flush(oio));
+
+  /* a write over prefetched windows, read or still pending, reads back */
+  uint8_t *patch = random_buf(len);
+  for (int pending = 0; pending < 2; pending++) {
+    size_t at = 1000000 + 13 * pending, n = 70001;
+    oio->prefetch(oio, 0, len);
+    if (!pending)
+      CHECK(oio->read_at(oio, out, len, 0) == len);
+    CHECK(oio->write_at(oio, patch + at, n, at) == n);
+    memcpy(in + at, patch + at, n);
+    CHECK(oio->read_at(oio, out, len, 0) == len);
+    CHECK(memcmp(in, out, len) == 0);
+  }
+  free(patch);
+  oio->destroy(oio);
+
+  /* every write fails, the decode reports it rather than the bytes queued */
+  if (access("/dev/full", W_OK) == 0) {
+    oio = ioctx_from_uring("/dev/full", 0);
+    CHECK(oio != NULL);
+    CHECK(nanorq_decode_block(dec, oio, 0) == 0);
+    CHECK(nanorq_decode_all(dec, oio, 4) == 0);
+    CHECK(oio->flush == NULL || !oio->flush(oio));
+    oio->destroy(oio);
+  }
+
+  nanorq_free(enc);
+  nanorq_free(dec);
+  io->destroy(io);
+  unlink(INPUT);
+  unlink(OUTPUT);
+  free(in);
+  free(out);
+  printf("uring ok\n");
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include "test.h"
+
+/* sends every block with loss percent of its source symbols dropped and as
+ * many repair symbols in their place, returns the decoder */
+static nanorq *transfer(nanorq *enc, struct ioctx *io, int loss,
+                        bool incremental) {
+  uint16_t T = nanorq_symbol_size(enc);
+  nanorq *dec = nanorq_decoder_new_ex(nanorq_oti_common(enc),
+                                      nanorq_oti_scheme_specific(enc),
+                                      incremental);
+  uint8_t sym[T];
+
+  CHECK(dec != NULL);
+  for (int sbn = 0; sbn < nanorq_blocks(enc); sbn++) {
+    uint32_t K = nanorq_block_symbols(enc, sbn), dropped = 0;
+    for (uint32_t esi = 0; esi < K + dropped + 2; esi++) {
+      if (esi < K && rand() % 100 < loss) {
+        dropped++;
+        continue;
+      }
+      CHECK(nanorq_encode(enc, sym, esi, sbn, io) == T);
+      CHECK(nanorq_decoder_add_symbol(dec, sym, nanorq_fid(sbn, esi)));
+    }
+  }
+  return dec;
+}
+
+/* round trips len bytes through an encoder of N sub-blocks per block */
+static void run(size_t len, uint16_t T, uint16_t SS, uint32_t WS,
+                uint16_t want_N, int threads, bool incremental) {
+  uint8_t *in = random_buf(len), *out = calloc(1, len);
+  struct ioctx *io = ioctx_from_mem(in, len);
+  struct ioctx *oio = ioctx_from_mem(out, len);
+  nanorq *enc = nanorq_encoder_new_ws(len, T, SS, WS, 8);
+
+  CHECK(enc != NULL);
+  CHECK(((nanorq_oti_scheme_specific(enc) >> 8) & 0xffff) == want_N);
+  if (threads)
+    CHECK(nanorq_generate_all(enc, io, threads));
+
+  nanorq *dec = transfer(enc, io, 20, incremental);
+  uint64_t written = 0;
+  if (threads) {
+    written = nanorq_decode_all(dec, oio, threads);
+  } else {
+    for (int sbn = 0; sbn < nanorq_blocks(dec); sbn++)
+      written += nanorq_decode_block(dec, oio, sbn);
+  }
+  CHECK(written == len);
+  CHECK(memcmp(in, out, len) == 0);
+
+  nanorq_free(enc);
+  nanorq_free(dec);
+  io->destroy(io);
+  oio->destroy(oio);
+  free(in);
+  free(out);
+}
+
+int main(int argc, char *argv[]) {
+  /* a budget too small for one sub-block of a symbol */
+  CHECK(nanorq_encoder_new_ws(1 << 20, 64, 0, 1000, 8) == NULL);
+  CHECK(nanorq_encoder_new_ws(1 << 20, 64, 1, 10, 8) == NULL);
+
+  /* one sub-block when the whole block fits */
+  run(64 * 1000, 64, 1, 1 << 24, 1, 0, false);
+
+  /* sub-blocks of unequal size, T / Al = 125 over N */
+  run(1000 * 3000, 1000, 5, 1 << 20, 3, 0, false);
+  run(1000 * 3000, 1000, 5, 1 << 20, 3, 4, false);
+  run(1000 * 3000, 1000, 5, 1 << 20, 3, 0, true);
+
+  /* several blocks of several sub-blocks */
+  run(1024 * 2000, 1024, 8, 64 * 1024, 16, 2, false);
+
+  printf("ws ok\n");
+  return 0;
+}